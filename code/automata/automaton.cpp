@@ -0,0 +1,193 @@
+#include "automaton.h"
+#include "shuffle_dfa.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+constexpr size_t SCAN_BLOCK = 64;
+
+void Automaton::init_table(const std::array<u8, ALPHABET_SIZE>& classes, i32 count)
+{
+    byte_class = classes;
+    num_classes = count;
+    class_shift = 0;
+    while ((1 << class_shift) < count) class_shift++;
+    table.assign((size_t)num_states << class_shift, DEAD_STATE);
+}
+
+i32 ComputeByteClasses(const Automaton& dfa, std::array<u8, ALPHABET_SIZE>& byte_class)
+{
+    // The table's own classes are merged where their columns agree, refined
+    // row by row so the table is read in order. Nothing is left to merge
+    // once every class stands alone.
+    i32 classes = dfa.num_classes;
+    std::vector<u8> merged(classes, 0);
+    std::vector<u32> rep(classes);
+    i32 k = 1;
+    for (u32 s = 0; s < (u32)dfa.num_states && k < classes; s++)
+    {
+        const u32* row = &dfa.table[(size_t)s << dfa.class_shift];
+        std::fill(rep.begin(), rep.end(), 0xFFFFFFFF);
+        bool split = false;
+        for (i32 c = 0; c < classes; c++)
+        {
+            u32& r = rep[merged[c]];
+            if (r == 0xFFFFFFFF) r = row[c];
+            else if (r != row[c]) split = true;
+        }
+        if (!split) continue;
+
+        // Renumber by (old class, target) pairs in order of first class.
+        std::vector<u8> old = merged;
+        i32 count = 0;
+        for (i32 c = 0; c < classes; c++)
+        {
+            i32 same = -1;
+            for (i32 a = 0; a < c; a++)
+            {
+                if (old[a] == old[c] && row[a] == row[c]) { same = a; break; }
+            }
+            merged[c] = same < 0 ? (u8)count++ : merged[same];
+        }
+        k = count;
+    }
+
+    // Bytes follow their class, numbered again by lowest byte.
+    std::vector<i32> number(k, -1);
+    i32 count = 0;
+    for (i32 b = 0; b < ALPHABET_SIZE; b++)
+    {
+        i32& m = number[merged[dfa.byte_class[b]]];
+        if (m < 0) m = count++;
+        byte_class[b] = (u8)m;
+    }
+    return k;
+}
+
+bool IsDeterministic(const CanvasCsr& csr)
+{
+    i32 initial = 0;
+    for (NODE_KIND kind: csr.kind) if (IsInitial(kind)) initial++;
+    if (initial > 1) return false;
+
+    // Rows are sorted by label and deduplicated, so a second target for a
+    // byte is always the next arc.
+    for (i32 s = 0; s < csr.num_states; s++)
+    {
+        for (const CsrArc* a = csr.begin(s); a != csr.end(s); a++)
+        {
+            if (a->label == CSR_EPSILON) return false;
+            if (a + 1 != csr.end(s) && a[1].label == a->label) return false;
+        }
+    }
+    return true;
+}
+
+Automaton CompileAutomaton(const CanvasCsr& csr)
+{
+    Automaton dfa = {};
+
+    // Sink first, then normal states, then accepting states.
+    std::vector<u32> state_of(csr.num_states, 0);
+    dfa.node_ids.push_back(0);
+    for (int pass = 0; pass < 2; pass++)
+    {
+        if (pass == 1) dfa.accept_base = (u32)dfa.node_ids.size();
+        for (i32 s = 0; s < csr.num_states; s++)
+        {
+            if (IsAccepting(csr.kind[s]) != (pass == 1)) continue;
+            state_of[s] = (u32)dfa.node_ids.size();
+            dfa.node_ids.push_back(csr.node_ids[s]);
+        }
+    }
+    dfa.num_states = (i32)dfa.node_ids.size();
+    dfa.init_table(csr.byte_class, csr.num_classes);
+
+    dfa.start = DEAD_STATE;
+    for (i32 s = 0; s < csr.num_states; s++)
+    {
+        if (!IsInitial(csr.kind[s])) continue;
+        if (dfa.start != DEAD_STATE)
+        {
+            throw std::runtime_error("AUTOMATON IS NOT DETERMINISTIC: MORE THAN ONE INIT NODE");
+        }
+        dfa.start = state_of[s];
+    }
+
+    for (i32 s = 0; s < csr.num_states; s++)
+    {
+        for (const CsrArc* a = csr.begin(s); a != csr.end(s); a++)
+        {
+            if (a->label == CSR_EPSILON)
+            {
+                throw std::runtime_error("AUTOMATON IS NOT DETERMINISTIC: q" + std::to_string(csr.node_ids[s]) + " HAS AN EPSILON ARC");
+            }
+            u32& entry = dfa.entry(state_of[s], a->label);
+            if (entry != DEAD_STATE && entry != state_of[a->to])
+            {
+                throw std::runtime_error("AUTOMATON IS NOT DETERMINISTIC: q" +
+                    std::to_string(csr.node_ids[s]) + " HAS TWO ARCS ON '" + (char)ByteSetFirst(csr.class_bytes[a->label]) + "'");
+            }
+            entry = state_of[a->to];
+        }
+    }
+
+    AttachShuffleDfa(dfa);
+    return dfa;
+}
+
+u32 Automaton::scan(std::string_view input, u32 state) const
+{
+    if (shuffle) return shuffle->scan(input, state);
+
+    const u8* p = (const u8*)input.data();
+    const u8* end = p + input.size();
+    const u32* t = table.data();
+    const u8* cls = byte_class.data();
+    u32 shift = class_shift;
+
+    // The sink is only checked once per block so the inner loop is nothing
+    // but dependent table loads.
+    while ((size_t)(end - p) >= SCAN_BLOCK)
+    {
+        for (size_t i = 0; i < SCAN_BLOCK; i += 4)
+        {
+            state = t[(state << shift) | cls[p[i + 0]]];
+            state = t[(state << shift) | cls[p[i + 1]]];
+            state = t[(state << shift) | cls[p[i + 2]]];
+            state = t[(state << shift) | cls[p[i + 3]]];
+        }
+        p += SCAN_BLOCK;
+        if (state == DEAD_STATE) return state;
+    }
+    while (p < end)
+    {
+        state = t[(state << shift) | cls[*p++]];
+    }
+    return state;
+}
+
+bool Automaton::accepts(std::string_view input) const
+{
+    return is_accepting(scan(input, start));
+}
+
+u32 Automaton::find_matches(std::string_view input, u32 state, u64 base_offset, MatchCallback callback, void* user) const
+{
+    const u8* p = (const u8*)input.data();
+    const u32* t = table.data();
+    const u8* cls = byte_class.data();
+    for (size_t i = 0; i < input.size(); i++)
+    {
+        state = t[(state << class_shift) | cls[p[i]]];
+        if (state >= accept_base)
+        {
+            callback(base_offset + i + 1, user);
+        }
+        else if (state == DEAD_STATE)
+        {
+            break;
+        }
+    }
+    return state;
+}
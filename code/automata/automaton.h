@@ -0,0 +1,66 @@
+#pragma once
+#ifndef AUTOMATON
+#define AUTOMATON
+
+#include <array>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include "../graph.h"
+#include "csr.h"
+#include "../vstd/vtypes.h"
+
+constexpr u32 DEAD_STATE = 0;
+
+struct ShuffleDfa;
+
+// Called with the offset just past every byte that leaves the automaton in
+// an accepting state.
+typedef void (*MatchCallback)(u64 end_offset, void* user);
+
+// Dense DFA compiled from the canvas. State 0 is the rejecting sink and the
+// accepting states are numbered last, so a match check is a single compare.
+// Rows are indexed by byte class, padded to a power of two so a step is
+// still a shift, an OR and a load.
+struct Automaton {
+    i32 num_states;
+    i32 num_classes;
+    u32 class_shift;            // a row is 1 << class_shift entries
+    u32 start;
+    u32 accept_base;
+    std::array<u8, ALPHABET_SIZE> byte_class;
+    std::vector<u32> table;     // num_states << class_shift
+    std::vector<i32> node_ids;  // canvas node of every state, 0 for the sink
+    std::shared_ptr<const ShuffleDfa> shuffle;  // set when the automaton is small enough
+
+    bool is_accepting(u32 state) const { return state >= accept_base; }
+    u32 next(u32 state, u8 byte) const { return table[(state << class_shift) | byte_class[byte]]; }
+    u32& entry(u32 state, i32 cls) { return table[((size_t)state << class_shift) | cls]; }
+
+    // Takes the classes and sizes the table for num_states, every entry
+    // going to the sink.
+    void init_table(const std::array<u8, ALPHABET_SIZE>& classes, i32 count);
+
+    // Runs input from state and returns the state it ends in, so long inputs
+    // can be fed in pieces.
+    u32 scan(std::string_view input, u32 state) const;
+    bool accepts(std::string_view input) const;
+
+    // Same as scan but reports matches, base_offset is added to every offset.
+    u32 find_matches(std::string_view input, u32 state, u64 base_offset, MatchCallback callback, void* user) const;
+};
+
+// Bytes whose columns are identical behave the same everywhere and share a
+// class. Coarser than the table's own classes when some of those turned out
+// to behave alike. Classes are numbered in order of their lowest byte;
+// returns how many there are.
+i32 ComputeByteClasses(const Automaton& dfa, std::array<u8, ALPHABET_SIZE>& byte_class);
+
+// At most one INIT node and no two arcs with the same label leaving a node
+// for different targets.
+bool IsDeterministic(const CanvasCsr& csr);
+
+// Throws std::runtime_error if the canvas is not deterministic.
+Automaton CompileAutomaton(const CanvasCsr& csr);
+
+#endif
@@ -0,0 +1,137 @@
+#include "batch.h"
+#include <algorithm>
+#include <vector>
+
+// Inputs up to this length are bucketed by length so a group of lanes can run
+// the same number of steps with no end checks at all.
+constexpr size_t BATCH_BUCKET_MAX_LEN = 256;
+constexpr size_t BATCH_WINDOW = 4096;
+
+// Runs the inputs in idx through lanes that are refilled as they finish.
+// Used for long inputs, where the shortest lane still gives long runs.
+static void RunLanes(const Automaton& dfa, const std::string_view* inputs, const size_t* idx, size_t count, u8* results)
+{
+    const u32* t = dfa.table.data();
+    const u8* cls = dfa.byte_class.data();
+    u32 shift = dfa.class_shift;
+    const u8* ptr[BATCH_LANES];
+    size_t left[BATCH_LANES];
+    u32 state[BATCH_LANES];
+    size_t owner[BATCH_LANES];
+    i32 lanes = 0;
+    size_t next = 0;
+
+    while (true)
+    {
+        while (lanes < BATCH_LANES && next < count)
+        {
+            size_t i = idx[next++];
+            ptr[lanes] = (const u8*)inputs[i].data();
+            left[lanes] = inputs[i].size();
+            state[lanes] = dfa.start;
+            owner[lanes] = i;
+            lanes++;
+        }
+        if (lanes == 0) break;
+
+        // Every lane can run this many bytes without checking for its end.
+        size_t steps = left[0];
+        for (i32 l = 1; l < lanes; l++) if (left[l] < steps) steps = left[l];
+
+        for (size_t k = 0; k < steps; k++)
+        {
+            for (i32 l = 0; l < lanes; l++) state[l] = t[(state[l] << shift) | cls[ptr[l][k]]];
+        }
+
+        // Retire finished or dead lanes and pack the rest to the front.
+        i32 kept = 0;
+        for (i32 l = 0; l < lanes; l++)
+        {
+            left[l] -= steps;
+            if (left[l] == 0 || state[l] == DEAD_STATE)
+            {
+                results[owner[l]] = left[l] == 0 && dfa.is_accepting(state[l]);
+                continue;
+            }
+            ptr[kept] = ptr[l] + steps;
+            left[kept] = left[l];
+            state[kept] = state[l];
+            owner[kept] = owner[l];
+            kept++;
+        }
+        lanes = kept;
+    }
+}
+
+// All inputs in idx have length len.
+static void RunBucket(const Automaton& dfa, const std::string_view* inputs, const size_t* idx, size_t count, size_t len, u8* results)
+{
+    const u32* t = dfa.table.data();
+    const u8* cls = dfa.byte_class.data();
+    u32 shift = dfa.class_shift;
+    const u8* ptr[BATCH_LANES];
+    u32 state[BATCH_LANES];
+
+    for (size_t base = 0; base < count; base += BATCH_LANES)
+    {
+        i32 lanes = count - base < BATCH_LANES ? (i32)(count - base) : BATCH_LANES;
+        for (i32 l = 0; l < lanes; l++)
+        {
+            ptr[l] = (const u8*)inputs[idx[base + l]].data();
+            state[l] = dfa.start;
+        }
+
+        if (lanes == BATCH_LANES)
+        {
+            for (size_t k = 0; k < len; k++)
+            {
+                for (i32 l = 0; l < BATCH_LANES; l++) state[l] = t[(state[l] << shift) | cls[ptr[l][k]]];
+            }
+        }
+        else
+        {
+            for (size_t k = 0; k < len; k++)
+            {
+                for (i32 l = 0; l < lanes; l++) state[l] = t[(state[l] << shift) | cls[ptr[l][k]]];
+            }
+        }
+
+        for (i32 l = 0; l < lanes; l++) results[idx[base + l]] = dfa.is_accepting(state[l]);
+    }
+}
+
+void AcceptsBatch(const Automaton& dfa, const std::string_view* inputs, size_t count, u8* results)
+{
+    std::vector<size_t> offsets(BATCH_BUCKET_MAX_LEN + 3);
+    std::vector<size_t> fill(BATCH_BUCKET_MAX_LEN + 2);
+    std::vector<size_t> idx(count < BATCH_WINDOW ? count : BATCH_WINDOW);
+
+    // Bucketing happens per window so the strings touched stay in cache.
+    for (size_t base = 0; base < count; base += BATCH_WINDOW)
+    {
+        size_t n = count - base < BATCH_WINDOW ? count - base : BATCH_WINDOW;
+        const std::string_view* window = inputs + base;
+
+        // Counting sort by length, everything longer shares the last bucket.
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for (size_t i = 0; i < n; i++)
+        {
+            size_t len = window[i].size();
+            offsets[(len <= BATCH_BUCKET_MAX_LEN ? len : BATCH_BUCKET_MAX_LEN + 1) + 1]++;
+        }
+        for (size_t b = 1; b < offsets.size(); b++) offsets[b] += offsets[b - 1];
+        std::copy(offsets.begin(), offsets.end() - 1, fill.begin());
+        for (size_t i = 0; i < n; i++)
+        {
+            size_t len = window[i].size();
+            idx[fill[len <= BATCH_BUCKET_MAX_LEN ? len : BATCH_BUCKET_MAX_LEN + 1]++] = i;
+        }
+
+        for (size_t len = 0; len <= BATCH_BUCKET_MAX_LEN; len++)
+        {
+            RunBucket(dfa, window, &idx[offsets[len]], offsets[len + 1] - offsets[len], len, results + base);
+        }
+        size_t long_begin = offsets[BATCH_BUCKET_MAX_LEN + 1];
+        RunLanes(dfa, window, &idx[long_begin], n - long_begin, results + base);
+    }
+}
@@ -0,0 +1,16 @@
+#pragma once
+#ifndef BATCH
+#define BATCH
+
+#include <string_view>
+#include "../vstd/vtypes.h"
+#include "automaton.h"
+
+constexpr i32 BATCH_LANES = 16;
+
+// results[i] = dfa.accepts(inputs[i]). Inputs are grouped by length and up
+// to BATCH_LANES of them run in lockstep, so their table loads overlap
+// instead of waiting on each other.
+void AcceptsBatch(const Automaton& dfa, const std::string_view* inputs, size_t count, u8* results);
+
+#endif
@@ -0,0 +1,79 @@
+#pragma once
+#ifndef BITSET
+#define BITSET
+
+#include <array>
+#include "../vstd/vtypes.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// State sets are plain arrays of u64 words; the owner keeps the word count.
+
+inline i32 BitsetWords(i32 bits) { return (bits + 63) / 64; }
+
+inline void BitsetSet(u64* set, i32 bit) { set[bit >> 6] |= (u64)1 << (bit & 63); }
+
+inline bool BitsetTest(const u64* set, i32 bit) { return (set[bit >> 6] >> (bit & 63)) & 1; }
+
+inline i32 CountTrailingZeros(u64 v)
+{
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanForward64(&idx, v);
+    return (i32)idx;
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
+inline i32 PopCount(u64 v)
+{
+#ifdef _MSC_VER
+    return (i32)__popcnt64(v);
+#else
+    return __builtin_popcountll(v);
+#endif
+}
+
+inline bool BitsetAny(const u64* set, i32 words)
+{
+    u64 acc = 0;
+    for (i32 i = 0; i < words; i++) acc |= set[i];
+    return acc != 0;
+}
+
+inline bool BitsetIntersects(const u64* a, const u64* b, i32 words)
+{
+    u64 acc = 0;
+    for (i32 i = 0; i < words; i++) acc |= a[i] & b[i];
+    return acc != 0;
+}
+
+inline bool BitsetSubset(const u64* a, const u64* b, i32 words)
+{
+    u64 acc = 0;
+    for (i32 i = 0; i < words; i++) acc |= a[i] & ~b[i];
+    return acc == 0;
+}
+
+constexpr i32 ALPHABET_SIZE = 256;
+
+// One bit per byte value, for arc labels and regex classes.
+typedef std::array<u64, 4> ByteSet;
+
+inline void ByteSetAddRange(ByteSet& set, i32 lo, i32 hi)
+{
+    for (i32 b = lo; b <= hi; b++) BitsetSet(set.data(), b);
+}
+
+inline bool ByteSetEmpty(const ByteSet& set) { return !BitsetAny(set.data(), 4); }
+
+// Lowest byte in set, ALPHABET_SIZE when it is empty.
+inline i32 ByteSetFirst(const ByteSet& set)
+{
+    for (i32 w = 0; w < 4; w++) if (set[w]) return w * 64 + CountTrailingZeros(set[w]);
+    return ALPHABET_SIZE;
+}
+
+#endif
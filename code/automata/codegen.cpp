@@ -0,0 +1,135 @@
+#include "codegen.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdio>
+#include <vector>
+
+static std::string ByteLiteral(i32 byte)
+{
+    char buff[8];
+    if (byte == '\'' || byte == '\\') snprintf(buff, sizeof(buff), "'\\%c'", byte);
+    else if (isprint(byte)) snprintf(buff, sizeof(buff), "'%c'", byte);
+    else snprintf(buff, sizeof(buff), "%d", byte);
+    return buff;
+}
+
+static std::string Identifier(const std::string& name)
+{
+    std::string id;
+    for (char c: name) id += isalnum((u8)c) ? c : '_';
+    if (id.empty() || isdigit((u8)id[0])) id = "m_" + id;
+    return id;
+}
+
+// Writes "case x: case y: <action>" for every live target of state. The
+// row is read once and sorted by target, so bytes going to the same state
+// end up together in ascending order.
+static void EmitCases(std::string& out, const Automaton& dfa, u32 state, const char* indent,
+                      const char* action_fmt)
+{
+    char buff[64];
+    std::array<std::pair<u32, i32>, ALPHABET_SIZE> cases;
+    i32 count = 0;
+    for (i32 c = 0; c < ALPHABET_SIZE; c++)
+    {
+        u32 target = dfa.next(state, (u8)c);
+        if (target != DEAD_STATE) cases[count++] = {target, c};
+    }
+    std::sort(cases.begin(), cases.begin() + count);
+    for (i32 i = 0; i < count; i++)
+    {
+        bool first = i == 0 || cases[i - 1].first != cases[i].first;
+        out += first ? indent : " ";
+        out += "case " + ByteLiteral(cases[i].second) + ":";
+        bool last = i + 1 == count || cases[i + 1].first != cases[i].first;
+        if (!last) continue;
+        snprintf(buff, sizeof(buff), action_fmt, cases[i].first);
+        out += std::string(" ") + buff + "\n";
+    }
+}
+
+// " // q<id>" naming the canvas node of s, nothing for states that have none,
+// as after determinizing or minimizing.
+static std::string NodeComment(const Automaton& dfa, u32 s)
+{
+    if (s >= dfa.node_ids.size() || dfa.node_ids[s] == 0) return "";
+    return " // q" + std::to_string(dfa.node_ids[s]);
+}
+
+std::string GenerateCpp(const Automaton& dfa, const std::string& name, bool as_constexpr)
+{
+    std::string fn = Identifier(name);
+    std::string out;
+    char buff[128];
+
+    out += "// Generated by PAINTOMATA, do not edit.\n";
+    // stddef.h, unlike cstddef, is sure to declare size_t unqualified.
+    out += "#pragma once\n#include <stddef.h>\n";
+    if (as_constexpr) out += "#include <string_view>\n";
+    out += "\n";
+
+    if (!as_constexpr)
+    {
+        out += "inline bool " + fn + "(const char* data, size_t size)\n{\n";
+        out += "    const unsigned char* p = (const unsigned char*)data;\n";
+        out += "    const unsigned char* end = p + size;\n";
+        if (dfa.start == DEAD_STATE)
+        {
+            out += "    (void)p; (void)end;\n    return false;\n}\n";
+            return out;
+        }
+        snprintf(buff, sizeof(buff), "    goto s%u;\n", dfa.start);
+        out += buff;
+
+        // Only states reachable from the start are emitted, so every label
+        // is the target of some goto and -Wunused-label stays quiet.
+        std::vector<bool> reached(dfa.num_states, false);
+        std::vector<u32> queue = {dfa.start};
+        reached[dfa.start] = true;
+        for (size_t head = 0; head < queue.size(); head++)
+        {
+            for (i32 c = 0; c < ALPHABET_SIZE; c++)
+            {
+                u32 to = dfa.next(queue[head], (u8)c);
+                if (to == DEAD_STATE || reached[to]) continue;
+                reached[to] = true;
+                queue.push_back(to);
+            }
+        }
+        for (u32 s = 1; s < (u32)dfa.num_states; s++)
+        {
+            if (!reached[s]) continue;
+            snprintf(buff, sizeof(buff), "s%u:", s);
+            out += buff + NodeComment(dfa, s) + "\n";
+            out += dfa.is_accepting(s) ? "    if (p == end) return true;\n" : "    if (p == end) return false;\n";
+            out += "    switch (*p++)\n    {\n";
+            EmitCases(out, dfa, s, "    ", "goto s%u;");
+            out += "    default: return false;\n    }\n";
+        }
+        out += "}\n";
+        return out;
+    }
+
+    out += "constexpr bool " + fn + "(std::string_view input)\n{\n";
+    snprintf(buff, sizeof(buff), "    unsigned state = %u;\n", dfa.start);
+    out += buff;
+    out += "    for (char c: input)\n    {\n";
+    out += "        switch (state)\n        {\n";
+    for (u32 s = 1; s < (u32)dfa.num_states; s++)
+    {
+        snprintf(buff, sizeof(buff), "        case %u:", s);
+        out += buff + NodeComment(dfa, s) + "\n";
+        out += "            switch ((unsigned char)c)\n            {\n";
+        EmitCases(out, dfa, s, "            ", "state = %u; break;");
+        out += "            default: return false;\n            }\n            break;\n";
+    }
+    out += "        default: return false;\n        }\n    }\n";
+    snprintf(buff, sizeof(buff), "    return state >= %u;\n}\n\n", dfa.accept_base);
+    out += buff;
+    out += "template <size_t N>\nconstexpr bool " + fn + "(const char (&literal)[N])\n{\n";
+    out += "    return " + fn + "(std::string_view(literal, N - 1));\n}\n\n";
+    out += "inline bool " + fn + "(const char* data, size_t size)\n{\n";
+    out += "    return " + fn + "(std::string_view(data, size));\n}\n";
+    return out;
+}
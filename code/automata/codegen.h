@@ -0,0 +1,15 @@
+#pragma once
+#ifndef CODEGEN
+#define CODEGEN
+
+#include <string>
+#include "automaton.h"
+
+// Emits a self contained header with `bool <name>(const char*, size_t)`.
+// Every state reachable from the start is a label with a switch on the next
+// byte, so the compiled matcher keeps its state in the program counter. With
+// as_constexpr the matcher is a constexpr loop over std::string_view instead,
+// plus a literal template overload so it can be used in static_assert.
+std::string GenerateCpp(const Automaton& dfa, const std::string& name, bool as_constexpr);
+
+#endif
@@ -0,0 +1,224 @@
+#include "csr.h"
+#include <algorithm>
+
+static bool ByLabel(const CsrArc& a, const CsrArc& b)
+{
+    return a.label != b.label ? a.label < b.label : a.to < b.to;
+}
+
+static bool SameArc(const CsrArc& a, const CsrArc& b)
+{
+    return a.label == b.label && a.to == b.to;
+}
+
+// Arcs leaving id are owned by id itself or by the other endpoint, which
+// then shows up in holders[id].
+template <typename F>
+static void ForEachArcFrom(const NodeStore& nodes, i32 id, F&& f)
+{
+    for (const auto& a: nodes.arcs[id])
+    {
+        if (a.info.node_id == id && IsLiveArc(nodes, a)) f(a);
+    }
+    for (i32 owner: nodes.holders[id])
+    {
+        for (const auto& a: nodes.arcs[owner])
+        {
+            if (a.info.node_id == id && IsLiveArc(nodes, a)) f(a);
+        }
+    }
+}
+
+// Splits every class the label cuts through. Classes are kept as byte
+// masks, so a label costs one pass over the classes, not over the bytes.
+static void RefineClasses(std::vector<ByteSet>& classes, const ByteSet& bytes)
+{
+    size_t count = classes.size();
+    for (size_t c = 0; c < count; c++)
+    {
+        ByteSet in, out;
+        for (i32 w = 0; w < 4; w++)
+        {
+            in[w] = classes[c][w] & bytes[w];
+            out[w] = classes[c][w] & ~bytes[w];
+        }
+        if (ByteSetEmpty(in) || ByteSetEmpty(out)) continue;
+        classes[c] = in;
+        classes.push_back(out);
+    }
+}
+
+// Every class is either inside the label or outside it.
+static bool FitsClasses(const CanvasCsr& csr, const ByteSet& bytes)
+{
+    for (const ByteSet& cls: csr.class_bytes)
+    {
+        u64 inside = 0, outside = 0;
+        for (i32 w = 0; w < 4; w++)
+        {
+            inside |= cls[w] & bytes[w];
+            outside |= cls[w] & ~bytes[w];
+        }
+        if (inside && outside) return false;
+    }
+    return true;
+}
+
+// Calls f with every class inside the label, or once with CSR_EPSILON.
+template <typename F>
+static void ForEachLabel(const CanvasCsr& csr, const arc& a, F&& f)
+{
+    if (a.epsilon)
+    {
+        f(CSR_EPSILON);
+        return;
+    }
+    for (i32 c = 0; c < csr.num_classes; c++)
+    {
+        if (BitsetTest(a.bytes.data(), ByteSetFirst(csr.class_bytes[c]))) f(c);
+    }
+}
+
+// Sorts and dedups arcs[first, end), returns the new end.
+static u32 FinishRow(std::vector<CsrArc>& arcs, u32 first, u32 end)
+{
+    std::sort(arcs.begin() + first, arcs.begin() + end, ByLabel);
+    return (u32)(std::unique(arcs.begin() + first, arcs.begin() + end, SameArc) - arcs.begin());
+}
+
+CanvasCsr BuildCsr(const NodeStore& nodes)
+{
+    CanvasCsr csr = {};
+    csr.node_ids = nodes.live;
+    std::sort(csr.node_ids.begin(), csr.node_ids.end());
+    csr.num_states = (i32)csr.node_ids.size();
+    csr.state_of_node.assign(nodes.slots(), -1);
+    csr.kind.resize(csr.num_states);
+    for (i32 s = 0; s < csr.num_states; s++)
+    {
+        csr.state_of_node[csr.node_ids[s]] = s;
+        csr.kind[s] = nodes.kind[csr.node_ids[s]];
+    }
+
+    // Runs of arcs with the same label are common, those are refined once.
+    std::vector<ByteSet> classes = {{~0ull, ~0ull, ~0ull, ~0ull}};
+    ByteSet last = classes[0];
+    for (i32 id: nodes.live)
+    {
+        for (const auto& a: nodes.arcs[id])
+        {
+            if (a.epsilon || a.bytes == last || !IsLiveArc(nodes, a)) continue;
+            RefineClasses(classes, a.bytes);
+            last = a.bytes;
+        }
+    }
+    std::sort(classes.begin(), classes.end(), [](const ByteSet& a, const ByteSet& b) {
+        return ByteSetFirst(a) < ByteSetFirst(b);
+    });
+    csr.num_classes = (i32)classes.size();
+    for (i32 c = 0; c < csr.num_classes; c++)
+    {
+        for (i32 b = 0; b < ALPHABET_SIZE; b++) if (BitsetTest(classes[c].data(), b)) csr.byte_class[b] = (u8)c;
+    }
+    csr.class_bytes = std::move(classes);
+
+    std::vector<u32> fill(csr.num_states + 1, 0);
+    for (i32 id: nodes.live)
+    {
+        for (const auto& a: nodes.arcs[id])
+        {
+            if (!IsLiveArc(nodes, a)) continue;
+            ForEachLabel(csr, a, [&](i32) { fill[csr.state_of_node[a.info.node_id] + 1]++; });
+        }
+    }
+    for (i32 s = 0; s < csr.num_states; s++) fill[s + 1] += fill[s];
+    csr.arcs.resize(fill[csr.num_states]);
+    std::vector<u32> start = fill;
+    for (i32 id: nodes.live)
+    {
+        for (const auto& a: nodes.arcs[id])
+        {
+            if (!IsLiveArc(nodes, a)) continue;
+            i32 from = csr.state_of_node[a.info.node_id];
+            i32 to = csr.state_of_node[a.info.other_id];
+            ForEachLabel(csr, a, [&](i32 label) { csr.arcs[fill[from]++] = {to, label}; });
+        }
+    }
+
+    // Rows shrink when duplicates go, so they are slid down as they finish.
+    csr.offsets.assign(csr.num_states + 1, 0);
+    u32 out = 0;
+    for (i32 s = 0; s < csr.num_states; s++)
+    {
+        u32 end = FinishRow(csr.arcs, start[s], start[s + 1]);
+        csr.offsets[s] = out;
+        for (u32 i = start[s]; i < end; i++) csr.arcs[out++] = csr.arcs[i];
+    }
+    csr.offsets[csr.num_states] = out;
+    csr.arcs.resize(out);
+    return csr;
+}
+
+void CsrCache::kind_changed(i32 node_id, NODE_KIND kind)
+{
+    if (fresh) csr.kind[csr.state_of_node[node_id]] = kind;
+}
+
+void CsrCache::node_added(i32 node_id, NODE_KIND kind)
+{
+    if (!fresh) return;
+    if (node_id >= (i32)csr.state_of_node.size()) csr.state_of_node.resize(node_id + 1, -1);
+    csr.state_of_node[node_id] = csr.num_states++;
+    csr.node_ids.push_back(node_id);
+    csr.kind.push_back(kind);
+    csr.offsets.push_back(csr.offsets.back());
+}
+
+const CanvasCsr& CsrCache::get(const NodeStore& nodes)
+{
+    if (!fresh)
+    {
+        csr = BuildCsr(nodes);
+        fresh = true;
+        dirty.clear();
+        return csr;
+    }
+    if (dirty.empty()) return csr;
+
+    bool fits = true;
+    for (i32 id: dirty)
+    {
+        ForEachArcFrom(nodes, id, [&](const arc& a) { fits = fits && (a.epsilon || FitsClasses(csr, a.bytes)); });
+    }
+    if (!fits)
+    {
+        fresh = false;
+        return get(nodes);
+    }
+
+    std::vector<bool> redo(csr.num_states, false);
+    for (i32 id: dirty) redo[csr.state_of_node[id]] = true;
+    dirty.clear();
+
+    std::vector<CsrArc> arcs;
+    arcs.reserve(csr.arcs.size() + 1);
+    std::vector<u32> offsets(csr.num_states + 1, 0);
+    for (i32 s = 0; s < csr.num_states; s++)
+    {
+        offsets[s] = (u32)arcs.size();
+        if (!redo[s])
+        {
+            arcs.insert(arcs.end(), csr.begin(s), csr.end(s));
+            continue;
+        }
+        ForEachArcFrom(nodes, csr.node_ids[s], [&](const arc& a) {
+            i32 to = csr.state_of_node[a.info.other_id];
+            ForEachLabel(csr, a, [&](i32 label) { arcs.push_back({to, label}); });
+        });
+        arcs.resize(FinishRow(arcs, offsets[s], (u32)arcs.size()));
+    }
+    offsets[csr.num_states] = (u32)arcs.size();
+    csr.arcs = std::move(arcs);
+    csr.offsets = std::move(offsets);
+    return csr;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#ifndef CSR
+#define CSR
+
+#include <array>
+#include <vector>
+#include "../graph.h"
+#include "../vstd/vtypes.h"
+
+constexpr i32 CSR_EPSILON = -1;
+
+struct CsrArc {
+    i32 to;     // state, not canvas id
+    i32 label;  // byte class, CSR_EPSILON for an empty move
+};
+
+// Frozen copy of the canvas for the engines. States are the live nodes
+// numbered densely and the arcs leaving a state are packed together in one
+// array, sorted by (label, to) without duplicates, so empty moves come
+// first and arcs on the same class are adjacent.
+//
+// Labels are byte classes rather than bytes: the alphabet is cut into the
+// pieces that no arc label splits, numbered by their lowest byte, and an
+// arc on [a-z] becomes one arc per class inside it. Tables built from this
+// are states x classes instead of states x 256.
+struct CanvasCsr {
+    i32 num_states;
+    i32 num_classes;
+    std::array<u8, ALPHABET_SIZE> byte_class;
+    std::vector<ByteSet> class_bytes;  // bytes of every class
+    std::vector<i32> node_ids;       // canvas id of every state
+    std::vector<i32> state_of_node;  // -1 for free slots
+    std::vector<NODE_KIND> kind;
+    std::vector<u32> offsets;        // arcs of s are [offsets[s], offsets[s + 1])
+    std::vector<CsrArc> arcs;
+
+    const CsrArc* begin(i32 s) const { return arcs.data() + offsets[s]; }
+    const CsrArc* end(i32 s) const { return arcs.data() + offsets[s + 1]; }
+};
+
+// One pass over the labels for the classes, then one counting pass and one
+// filling pass over the arcs; states follow canvas id order.
+CanvasCsr BuildCsr(const NodeStore& nodes);
+
+// Keeps a CanvasCsr in step with the canvas. Edits only record what they
+// touched: get() regathers just the rows whose arcs changed and copies the
+// rest, a new node appends an empty row, and only deleting or replacing
+// nodes renumbers the states from scratch, as does a label that cuts
+// through one of the current classes.
+struct CsrCache {
+    CanvasCsr csr;
+    bool fresh;
+    std::vector<i32> dirty;  // canvas ids whose outgoing arcs changed
+
+    void arcs_changed(i32 node_id) { dirty.push_back(node_id); }
+    void kind_changed(i32 node_id, NODE_KIND kind);
+    void node_added(i32 node_id, NODE_KIND kind);
+    void nodes_changed() { fresh = false; }
+    const CanvasCsr& get(const NodeStore& nodes);
+};
+
+#endif
@@ -0,0 +1,269 @@
+#include "determinize.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include "shuffle_dfa.h"
+
+constexpr u32 EMPTY_SLOT = 0xFFFFFFFF;
+
+static u64 HashWords(const u64* set, i32 words)
+{
+    u64 h = 0x9E3779B97F4A7C15ull;
+    for (i32 i = 0; i < words; i++)
+    {
+        h ^= set[i];
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 32;
+    }
+    return h;
+}
+
+// One shard of the interning table. Only touched under its lock.
+struct SetShard {
+    std::mutex lock;
+    std::vector<u64> sets;    // packed, num_words per entry
+    std::vector<u32> ids;     // global id of every entry
+    std::vector<u32> slots;   // open addressing, entry index
+    std::vector<u32> fresh;   // entries added during this level
+};
+
+struct SetTable {
+    i32 words;
+    std::atomic<u32> next_id;
+    SetShard shards[DETERMINIZE_SHARDS];
+
+    // Returns the id of set, adding it if it is new.
+    u32 intern(const u64* set)
+    {
+        u64 h = HashWords(set, words);
+        SetShard& shard = shards[h % DETERMINIZE_SHARDS];
+        h /= DETERMINIZE_SHARDS;
+
+        std::lock_guard<std::mutex> guard(shard.lock);
+        if (shard.ids.size() * 2 >= shard.slots.size()) grow(shard);
+        size_t mask = shard.slots.size() - 1;
+        size_t slot = h & mask;
+        while (shard.slots[slot] != EMPTY_SLOT)
+        {
+            u32 entry = shard.slots[slot];
+            if (memcmp(&shard.sets[(size_t)entry * words], set, sizeof(u64) * words) == 0) return shard.ids[entry];
+            slot = (slot + 1) & mask;
+        }
+
+        u32 entry = (u32)shard.ids.size();
+        u32 id = next_id.fetch_add(1);
+        shard.sets.insert(shard.sets.end(), set, set + words);
+        shard.ids.push_back(id);
+        shard.fresh.push_back(entry);
+        shard.slots[slot] = entry;
+        return id;
+    }
+
+    void grow(SetShard& shard)
+    {
+        size_t size = shard.slots.empty() ? 64 : shard.slots.size() * 2;
+        shard.slots.assign(size, EMPTY_SLOT);
+        for (u32 entry = 0; entry < shard.ids.size(); entry++)
+        {
+            size_t slot = (HashWords(&shard.sets[(size_t)entry * words], words) / DETERMINIZE_SHARDS) & (size - 1);
+            while (shard.slots[slot] != EMPTY_SLOT) slot = (slot + 1) & (size - 1);
+            shard.slots[slot] = entry;
+        }
+    }
+};
+
+struct Barrier {
+    std::mutex lock;
+    std::condition_variable cv;
+    i32 count;
+    i32 waiting;
+    u64 generation;
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        u64 gen = generation;
+        if (++waiting == count)
+        {
+            waiting = 0;
+            generation++;
+            cv.notify_all();
+            return;
+        }
+        cv.wait(guard, [&]() { return gen != generation; });
+    }
+};
+
+Automaton CompileDeterministic(const CanvasCsr& csr)
+{
+    if (IsDeterministic(csr)) return CompileAutomaton(csr);
+    return Determinize(CompileNfa(csr));
+}
+
+Automaton Determinize(const Nfa& nfa, i32 num_threads)
+{
+    if (num_threads <= 0)
+    {
+        bool small = nfa.num_states < DETERMINIZE_PARALLEL_MIN_STATES;
+        num_threads = small ? 1 : (i32)std::thread::hardware_concurrency();
+    }
+    if (num_threads < 1) num_threads = 1;
+
+    i32 words = nfa.num_words;
+    i32 classes = nfa.num_classes;
+    std::array<u8, ALPHABET_SIZE> class_byte;
+    for (i32 b = ALPHABET_SIZE - 1; b >= 0; b--) class_byte[nfa.byte_class[b]] = (u8)b;
+
+    std::unique_ptr<SetTable> table = std::make_unique<SetTable>();
+    table->words = words;
+    table->next_id = 0;
+
+    // Id 0 is the empty set, which becomes the sink.
+    std::vector<u64> empty(words, 0);
+    table->intern(empty.data());
+    u32 start = table->intern(nfa.initial.data());
+
+    std::vector<u64> frontier;       // packed sets of this level
+    std::vector<u32> frontier_ids;
+    std::vector<u32> trans;          // [id][class]
+    std::vector<u8> accepting;
+    bool failed = false;
+
+    // Moves the sets added since the last call into the next frontier.
+    auto collect = [&]() {
+        frontier.clear();
+        frontier_ids.clear();
+        for (auto& shard: table->shards)
+        {
+            for (u32 entry: shard.fresh)
+            {
+                frontier.insert(frontier.end(), &shard.sets[(size_t)entry * words], &shard.sets[(size_t)(entry + 1) * words]);
+                frontier_ids.push_back(shard.ids[entry]);
+            }
+            shard.fresh.clear();
+        }
+        u32 total = table->next_id;
+        if (total > (u32)DETERMINIZE_MAX_STATES)
+        {
+            failed = true;
+            frontier_ids.clear();
+        }
+        trans.resize((size_t)total * classes, 0);
+        accepting.resize(total, 0);
+    };
+    collect();
+
+    Barrier barrier;
+    barrier.count = num_threads;
+    barrier.waiting = 0;
+    barrier.generation = 0;
+    std::atomic<size_t> cursor(0);
+
+    // The first exception wins. Workers keep meeting at the barriers so
+    // none is left waiting, and the next collect ends the search.
+    std::mutex error_lock;
+    std::exception_ptr error;
+    std::atomic<bool> stop(false);
+    auto record = [&]() {
+        std::lock_guard<std::mutex> guard(error_lock);
+        if (!error) error = std::current_exception();
+        stop = true;
+    };
+
+    auto worker = [&](i32 idx) {
+        std::vector<u64> next;
+        while (true)
+        {
+            if (frontier_ids.empty()) return;
+            try
+            {
+                next.resize(words);
+                size_t i;
+                while (!stop && (i = cursor.fetch_add(1)) < frontier_ids.size())
+                {
+                    const u64* set = &frontier[i * words];
+                    u32 id = frontier_ids[i];
+                    accepting[id] = nfa.is_accepting(set);
+                    for (i32 c = 0; c < classes; c++)
+                    {
+                        nfa.step(set, class_byte[c], next.data());
+                        trans[(size_t)id * classes + c] = table->intern(next.data());
+                    }
+                }
+            }
+            catch (...)
+            {
+                record();
+            }
+            barrier.wait();
+            if (idx == 0)
+            {
+                try
+                {
+                    if (!stop) collect();
+                }
+                catch (...)
+                {
+                    record();
+                }
+                if (stop) frontier_ids.clear();
+                cursor = 0;
+            }
+            barrier.wait();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    try
+    {
+        for (i32 i = 1; i < num_threads; i++) workers.emplace_back(worker, i);
+    }
+    catch (const std::system_error&)
+    {
+        // Run with the threads that did start.
+        std::lock_guard<std::mutex> guard(barrier.lock);
+        barrier.count = (i32)workers.size() + 1;
+    }
+    worker(0);
+    for (auto& w: workers) w.join();
+    table.reset();
+
+    if (error) std::rethrow_exception(error);
+
+    if (failed)
+    {
+        throw std::runtime_error("DETERMINIZE ABORTED: MORE THAN " + std::to_string(DETERMINIZE_MAX_STATES) + " STATES");
+    }
+
+    // Renumber so the sink is 0 and accepting states come last.
+    u32 total = (u32)accepting.size();
+    std::vector<u32> order(total);
+    Automaton dfa = {};
+    dfa.num_states = (i32)total;
+    u32 next_id = 0;
+    order[0] = next_id++;
+    for (i32 pass = 0; pass < 2; pass++)
+    {
+        if (pass == 1) dfa.accept_base = next_id;
+        for (u32 id = 1; id < total; id++)
+        {
+            if (accepting[id] == pass) order[id] = next_id++;
+        }
+    }
+
+    dfa.start = order[start];
+    dfa.node_ids.assign(total, 0);
+    dfa.init_table(nfa.byte_class, classes);
+    for (u32 id = 1; id < total; id++)
+    {
+        for (i32 c = 0; c < classes; c++) dfa.entry(order[id], c) = order[trans[(size_t)id * classes + c]];
+    }
+    AttachShuffleDfa(dfa);
+    return dfa;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#ifndef DETERMINIZE
+#define DETERMINIZE
+
+#include "../vstd/vtypes.h"
+#include "automaton.h"
+#include "nfa.h"
+
+constexpr i32 DETERMINIZE_MAX_STATES = 1 << 24;
+constexpr i32 DETERMINIZE_SHARDS = 64;
+constexpr i32 DETERMINIZE_PARALLEL_MIN_STATES = 256;
+
+// Subset construction. The frontier of every BFS level is split between
+// num_threads workers (0 = all hardware threads, or one for NFAs under
+// DETERMINIZE_PARALLEL_MIN_STATES); state sets are interned in a sharded hash
+// table with the sets themselves packed in per shard arenas.
+// Throws std::runtime_error past DETERMINIZE_MAX_STATES; an exception in a
+// worker is rethrown on the caller.
+Automaton Determinize(const Nfa& nfa, i32 num_threads = 0);
+
+// CompileAutomaton when the canvas is already deterministic, Determinize
+// of its Nfa otherwise.
+Automaton CompileDeterministic(const CanvasCsr& csr);
+
+#endif
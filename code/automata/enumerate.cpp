@@ -0,0 +1,129 @@
+#include "enumerate.h"
+#include <algorithm>
+
+constexpr u32 NO_PARENT = 0xFFFFFFFF;
+
+WordEnumerator MakeWordEnumerator(Automaton dfa, bool accepted, u32 limit)
+{
+    WordEnumerator e = {};
+    e.dfa = std::move(dfa);
+    e.accepted = accepted;
+    e.limit = limit;
+
+    // States that can reach a wanted one, walking predecessor lists
+    // backwards. Rows are reduced to their distinct targets first, which
+    // are few for anything drawn or built from a pattern.
+    const Automaton& d = e.dfa;
+    u32 n = (u32)d.num_states;
+    std::array<u8, ALPHABET_SIZE> byte_class;
+    i32 k = ComputeByteClasses(d, byte_class);
+    std::vector<u8> class_byte(k);
+    for (i32 b = ALPHABET_SIZE - 1; b >= 0; b--) class_byte[byte_class[b]] = (u8)b;
+
+    std::vector<u32> succ_start(n + 1, 0);
+    std::vector<u32> succ;
+    std::vector<u32> seen_in(n, 0xFFFFFFFF);
+    for (u32 s = 0; s < n; s++)
+    {
+        for (i32 c = 0; c < k; c++)
+        {
+            u32 t = d.next(s, class_byte[c]);
+            if (seen_in[t] == s) continue;
+            seen_in[t] = s;
+            succ.push_back(t);
+        }
+        succ_start[s + 1] = (u32)succ.size();
+    }
+    std::vector<u32> pred_start(n + 1, 0);
+    for (u32 t: succ) pred_start[t + 1]++;
+    for (u32 s = 0; s < n; s++) pred_start[s + 1] += pred_start[s];
+    std::vector<u32> pred(succ.size());
+    {
+        std::vector<u32> fill(pred_start.begin(), pred_start.end() - 1);
+        for (u32 s = 0; s < n; s++)
+        {
+            for (u32 i = succ_start[s]; i < succ_start[s + 1]; i++) pred[fill[succ[i]]++] = s;
+        }
+    }
+
+    e.live.assign(n, false);
+    std::vector<u32> stack;
+    for (u32 s = 0; s < n; s++)
+    {
+        if (d.is_accepting(s) == accepted)
+        {
+            e.live[s] = true;
+            stack.push_back(s);
+        }
+    }
+    while (!stack.empty())
+    {
+        u32 s = stack.back();
+        stack.pop_back();
+        for (u32 i = pred_start[s]; i < pred_start[s + 1]; i++)
+        {
+            if (e.live[pred[i]]) continue;
+            e.live[pred[i]] = true;
+            stack.push_back(pred[i]);
+        }
+    }
+
+    e.visits.assign(n, 0);
+    if (limit > 0 && e.live[d.start])
+    {
+        e.state.push_back(d.start);
+        e.parent.push_back(NO_PARENT);
+        e.byte.push_back(0);
+        e.visits[d.start] = 1;
+    }
+    return e;
+}
+
+static void Spell(const WordEnumerator& e, u32 entry, std::string* word)
+{
+    word->clear();
+    for (u32 i = entry; e.parent[i] != NO_PARENT; i = e.parent[i]) *word += (char)e.byte[i];
+    std::reverse(word->begin(), word->end());
+}
+
+bool WordEnumerator::next(std::string* word)
+{
+    if (!started)
+    {
+        started = true;
+        if (!state.empty() && dfa.is_accepting(state[0]) == accepted)
+        {
+            found++;
+            word->clear();
+            return true;
+        }
+    }
+
+    // Children are only created as the scan reaches them, so a level is
+    // never stored past the word that fills the limit.
+    while (!done())
+    {
+        u32 s = state[head];
+        while (next_byte < ALPHABET_SIZE)
+        {
+            u32 t = dfa.next(s, (u8)next_byte++);
+            if (!live[t] || visits[t] >= limit) continue;
+            visits[t]++;
+            state.push_back(t);
+            parent.push_back((u32)head);
+            byte.push_back((u8)(next_byte - 1));
+            if (dfa.is_accepting(t) != accepted) continue;
+            found++;
+            Spell(*this, (u32)state.size() - 1, word);
+            return true;
+        }
+        head++;
+        next_byte = 0;
+    }
+    return false;
+}
+
+size_t WordEnumerator::bytes() const
+{
+    return sizeof(u32) * (state.capacity() + parent.capacity() + visits.capacity()) + byte.capacity() + live.capacity() / 8;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#ifndef ENUMERATE
+#define ENUMERATE
+
+#include <string>
+#include <vector>
+#include "../vstd/vtypes.h"
+#include "automaton.h"
+
+constexpr u32 ENUMERATE_MAX_ENTRIES = 1 << 26;
+
+// Words of the automaton, or of its complement, in length-lexicographic
+// order. The queue holds one entry per prefix as (state, parent entry,
+// last byte), so a word is only spelled out when it is returned. A state is
+// entered at most limit times: a later prefix reaching it is beaten by limit
+// earlier ones with every suffix, so it cannot be among the first limit
+// words. That caps the queue at limit * num_states entries.
+struct WordEnumerator {
+    Automaton dfa;
+    bool accepted;           // enumerate L(dfa) or its complement
+    u32 limit;
+    u32 found;
+    bool started;
+    size_t head;             // entry whose children are being created
+    i32 next_byte;
+    std::vector<u32> state;  // [entry]
+    std::vector<u32> parent;
+    std::vector<u8> byte;
+    std::vector<u32> visits; // [state]
+    std::vector<bool> live;  // [state] can still reach a wanted state
+
+    // Stays set once the queue reaches ENUMERATE_MAX_ENTRIES, the words
+    // found so far are all there will be.
+    bool truncated() const { return state.size() >= ENUMERATE_MAX_ENTRIES; }
+    bool done() const { return found >= limit || head >= state.size() || truncated(); }
+    // Returns false once done.
+    bool next(std::string* word);
+    size_t bytes() const;
+};
+
+WordEnumerator MakeWordEnumerator(Automaton dfa, bool accepted, u32 limit);
+
+#endif
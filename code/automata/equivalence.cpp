@@ -0,0 +1,91 @@
+#include "equivalence.h"
+#include <algorithm>
+#include "subsets.h"
+
+constexpr u32 NO_PARENT = 0xFFFFFFFF;
+
+struct PairStep {
+    u32 a;
+    u32 b;
+    u32 parent;
+    u8 byte;
+};
+
+// Union-find over both subset spaces, a's set i is 2i and b's set i is 2i+1.
+struct UnionFind {
+    std::vector<u32> parent;
+    std::vector<u32> size;
+
+    u32 find(u32 x)
+    {
+        if (x >= parent.size())
+        {
+            size_t old = parent.size();
+            parent.resize(std::max<size_t>(x + 1, old * 2));
+            size.resize(parent.size(), 1);
+            for (size_t i = old; i < parent.size(); i++) parent[i] = (u32)i;
+        }
+        while (parent[x] != x)
+        {
+            parent[x] = parent[parent[x]];
+            x = parent[x];
+        }
+        return x;
+    }
+
+    // False when x and y were already in one class.
+    bool unite(u32 x, u32 y)
+    {
+        x = find(x);
+        y = find(y);
+        if (x == y) return false;
+        if (size[x] < size[y]) std::swap(x, y);
+        parent[y] = x;
+        size[x] += size[y];
+        return true;
+    }
+};
+
+EquivalenceResult CheckEquivalence(const Nfa& a, const Nfa& b)
+{
+    EquivalenceResult result = {};
+    result.equivalent = true;
+
+    std::vector<u8> bytes = JointClassBytes(a, b);
+
+    SubsetSpace sa = MakeSubsetSpace(a);
+    SubsetSpace sb = MakeSubsetSpace(b);
+    UnionFind uf;
+    std::vector<PairStep> queue;
+    queue.push_back({sa.initial(), sb.initial(), NO_PARENT, 0});
+    uf.unite(queue[0].a * 2, queue[0].b * 2 + 1);
+
+    // Breadth first, so the first mismatch ends the shortest counterexample.
+    for (size_t head = 0; head < queue.size(); head++)
+    {
+        PairStep cur = queue[head];
+        if (sa.accepting(cur.a) != sb.accepting(cur.b))
+        {
+            result.equivalent = false;
+            result.accepted_by_a = sa.accepting(cur.a);
+            for (u32 i = (u32)head; queue[i].parent != NO_PARENT; i = queue[i].parent)
+            {
+                result.counterexample += (char)queue[i].byte;
+            }
+            std::reverse(result.counterexample.begin(), result.counterexample.end());
+            break;
+        }
+
+        for (u8 byte: bytes)
+        {
+            u32 na = sa.next(cur.a, byte);
+            u32 nb = sb.next(cur.b, byte);
+            if (uf.unite(na * 2, nb * 2 + 1)) queue.push_back({na, nb, (u32)head, byte});
+        }
+    }
+
+    result.pairs = queue.size();
+    result.bytes = sa.bytes() + sb.bytes() + sizeof(PairStep) * queue.capacity()
+        + sizeof(u32) * (uf.parent.capacity() + uf.size.capacity());
+    return result;
+}
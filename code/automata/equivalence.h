@@ -0,0 +1,22 @@
+#pragma once
+#ifndef EQUIVALENCE
+#define EQUIVALENCE
+
+#include <string>
+#include "../vstd/vtypes.h"
+#include "nfa.h"
+
+struct EquivalenceResult {
+    bool equivalent;
+    std::string counterexample;  // shortest word accepted by exactly one side
+    bool accepted_by_a;
+    u64 pairs;                   // product pairs expanded
+    size_t bytes;
+};
+
+// Hopcroft-Karp: walks pairs of subsets of a and b breadth first and merges
+// them in a union-find, so only pairs not already implied are expanded.
+// Neither side is determinized up front.
+EquivalenceResult CheckEquivalence(const Nfa& a, const Nfa& b);
+
+#endif
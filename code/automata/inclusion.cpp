@@ -0,0 +1,99 @@
+#include "inclusion.h"
+#include <algorithm>
+#include "subsets.h"
+
+constexpr u32 NO_PARENT = 0xFFFFFFFF;
+
+struct ChainEntry {
+    u32 state;
+    u32 set;
+    u32 parent;
+    u32 depth;
+    u8 byte;
+    bool removed;
+};
+
+// Adds (state, set) unless it is subsumed, and drops the entries it subsumes
+// from the antichain, which keeps one list per state of a. A dropped entry
+// still waiting in the queue at a smaller depth is expanded anyway so the
+// counterexample stays the shortest.
+static void Insert(std::vector<ChainEntry>& entries, std::vector<std::vector<u32>>& chains, const SubsetSpace& sb,
+                   u32 state, u32 set, u32 parent, u8 byte)
+{
+    u32 depth = parent == NO_PARENT ? 0 : entries[parent].depth + 1;
+    i32 words = sb.nfa->num_words;
+    std::vector<u32>& chain = chains[state];
+    for (u32 e: chain)
+    {
+        if (BitsetSubset(sb.set(entries[e].set), sb.set(set), words)) return;
+    }
+
+    size_t kept = 0;
+    for (u32 e: chain)
+    {
+        if (!BitsetSubset(sb.set(set), sb.set(entries[e].set), words)) chain[kept++] = e;
+        else if (entries[e].depth >= depth) entries[e].removed = true;
+    }
+    chain.resize(kept);
+    chain.push_back((u32)entries.size());
+    entries.push_back({state, set, parent, depth, byte, false});
+}
+
+InclusionResult CheckInclusion(const Nfa& a, const Nfa& b)
+{
+    InclusionResult result = {};
+    result.included = true;
+
+    std::vector<u8> bytes = JointClassBytes(a, b);
+    SubsetSpace sb = MakeSubsetSpace(b);
+    std::vector<ChainEntry> entries;
+    std::vector<std::vector<u32>> chains(a.num_states);
+
+    u32 start = sb.initial();
+    for (i32 p = 0; p < a.num_states; p++)
+    {
+        if (BitsetTest(a.initial.data(), p)) Insert(entries, chains, sb, (u32)p, start, NO_PARENT, 0);
+    }
+
+    std::vector<u64> single(a.num_words);
+    std::vector<u64> succ(a.num_words);
+    for (size_t head = 0; head < entries.size(); head++)
+    {
+        if (entries[head].removed) continue;
+        ChainEntry cur = entries[head];
+        if (BitsetTest(a.accepting.data(), cur.state) && !sb.accepting(cur.set))
+        {
+            result.included = false;
+            for (u32 i = (u32)head; entries[i].parent != NO_PARENT; i = entries[i].parent)
+            {
+                result.counterexample += (char)entries[i].byte;
+            }
+            std::reverse(result.counterexample.begin(), result.counterexample.end());
+            break;
+        }
+
+        std::fill(single.begin(), single.end(), 0);
+        BitsetSet(single.data(), cur.state);
+        for (u8 byte: bytes)
+        {
+            a.step(single.data(), byte, succ.data());
+            if (!BitsetAny(succ.data(), a.num_words)) continue;
+            u32 next = sb.next(cur.set, byte);
+            for (i32 w = 0; w < a.num_words; w++)
+            {
+                u64 bits = succ[w];
+                while (bits)
+                {
+                    u32 p = (u32)(w * 64 + CountTrailingZeros(bits));
+                    bits &= bits - 1;
+                    Insert(entries, chains, sb, p, next, (u32)head, byte);
+                }
+            }
+        }
+    }
+
+    result.pairs = entries.size();
+    result.bytes = sb.bytes() + sizeof(ChainEntry) * entries.capacity();
+    for (const auto& chain: chains) result.bytes += sizeof(u32) * chain.capacity();
+    return result;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#ifndef INCLUSION
+#define INCLUSION
+
+#include <string>
+#include "../vstd/vtypes.h"
+#include "nfa.h"
+
+struct InclusionResult {
+    bool included;
+    std::string counterexample;  // shortest word in L(a) but not in L(b)
+    u64 pairs;                   // (state of a, subset of b) pairs kept
+    size_t bytes;
+};
+
+// L(a) subset of L(b) without complementing b. Explores pairs of a state of
+// a with the subset of b reached by the same word, breadth first, and drops
+// a pair when another one with the same state and a smaller subset is known:
+// every word that fails from the larger subset fails from the smaller too.
+InclusionResult CheckInclusion(const Nfa& a, const Nfa& b);
+
+#endif
@@ -0,0 +1,128 @@
+#include "lazy_dfa.h"
+#include <cstring>
+
+constexpr u32 LAZY_UNKNOWN = 0xFFFFFFFF;
+constexpr u32 LAZY_EMPTY_SLOT = 0xFFFFFFFF;
+
+static u64 HashSet(const u64* set, i32 words)
+{
+    u64 h = 0x9E3779B97F4A7C15ull;
+    for (i32 i = 0; i < words; i++)
+    {
+        h ^= set[i];
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 32;
+    }
+    return h;
+}
+
+LazyDfa MakeLazyDfa(const Nfa& nfa, size_t cache_bytes)
+{
+    LazyDfa dfa = {};
+    dfa.nfa = &nfa;
+    dfa.cache_bytes = cache_bytes;
+
+    // Each state costs its set, its transition row and two hash slots.
+    size_t per_state = sizeof(u64) * nfa.num_words + sizeof(u32) * nfa.num_classes + sizeof(u32) * 2;
+    dfa.max_states = (i32)(cache_bytes / per_state);
+    if (dfa.max_states < 2) dfa.max_states = 2;
+
+    size_t num_slots = 1;
+    while (num_slots < (size_t)dfa.max_states * 2) num_slots <<= 1;
+    dfa.sets.resize((size_t)dfa.max_states * nfa.num_words);
+    dfa.trans.resize((size_t)dfa.max_states * nfa.num_classes);
+    dfa.slots.resize(num_slots);
+    dfa.flush();
+    dfa.stats = {};
+    return dfa;
+}
+
+void LazyDfa::flush()
+{
+    num_states = 0;
+    std::fill(slots.begin(), slots.end(), LAZY_EMPTY_SLOT);
+    stats.flushes++;
+}
+
+u32 LazyDfa::intern(const u64* set)
+{
+    i32 words = nfa->num_words;
+    u32 id = (u32)num_states++;
+    memcpy(&sets[(size_t)id * words], set, sizeof(u64) * words);
+    std::fill_n(&trans[(size_t)id * nfa->num_classes], nfa->num_classes, LAZY_UNKNOWN);
+    return id;
+}
+
+u32 LazyDfa::find_or_add(const u64* set)
+{
+    i32 words = nfa->num_words;
+    size_t mask = slots.size() - 1;
+    size_t slot = HashSet(set, words) & mask;
+    while (slots[slot] != LAZY_EMPTY_SLOT)
+    {
+        u32 id = slots[slot];
+        if (memcmp(&sets[(size_t)id * words], set, sizeof(u64) * words) == 0) return id;
+        slot = (slot + 1) & mask;
+    }
+    u32 id = intern(set);
+    slots[slot] = id;
+    return id;
+}
+
+void LazyDfa::scan(std::string_view input, u64* set)
+{
+    const u8* p = (const u8*)input.data();
+    const u8* end = p + input.size();
+    i32 words = nfa->num_words;
+    i32 classes = nfa->num_classes;
+    const u8* cls = nfa->byte_class.data();
+
+    std::vector<u64> next(words);
+    if (num_states == max_states) flush();
+    u32 s = find_or_add(set);
+    const u8* last_flush = p;
+    u64 misses = 0;
+
+    while (p < end)
+    {
+        u32 t = trans[(size_t)s * classes + cls[*p]];
+        if (t == LAZY_UNKNOWN)
+        {
+            misses++;
+            nfa->step(&sets[(size_t)s * words], *p, next.data());
+            if (num_states == max_states)
+            {
+                if ((size_t)(p - last_flush) < LAZY_DFA_MIN_BYTES_PER_STATE * max_states)
+                {
+                    // Thrashing, finish this input on the NFA.
+                    memcpy(set, next.data(), sizeof(u64) * words);
+                    p++;
+                    stats.fallback_bytes += end - p;
+                    nfa->scan(std::string_view((const char*)p, end - p), set);
+                    stats.misses += misses;
+                    stats.hits += (u64)(p - (const u8*)input.data()) - misses;
+                    return;
+                }
+                memcpy(set, &sets[(size_t)s * words], sizeof(u64) * words);
+                flush();
+                last_flush = p;
+                s = find_or_add(set);
+            }
+            t = find_or_add(next.data());
+            trans[(size_t)s * classes + cls[*p]] = t;
+        }
+        s = t;
+        p++;
+    }
+
+    stats.misses += misses;
+    stats.hits += input.size() - misses;
+    memcpy(set, &sets[(size_t)s * words], sizeof(u64) * words);
+}
+
+bool LazyDfa::accepts(std::string_view input)
+{
+    std::vector<u64> set = nfa->initial;
+    scan(input, set.data());
+    return nfa->is_accepting(set.data());
+}
@@ -0,0 +1,46 @@
+#pragma once
+#ifndef LAZY_DFA
+#define LAZY_DFA
+
+#include <string_view>
+#include <vector>
+#include "../vstd/vtypes.h"
+#include "nfa.h"
+
+constexpr size_t LAZY_DFA_DEFAULT_CACHE = 1 << 20;
+// A flush that comes sooner than this many bytes per cached state means the
+// cache is thrashing and the rest of the input is run on the NFA.
+constexpr size_t LAZY_DFA_MIN_BYTES_PER_STATE = 10;
+
+struct LazyDfaStats {
+    u64 hits;
+    u64 misses;
+    u64 flushes;
+    u64 fallback_bytes;
+
+    f64 hit_rate() const { return hits + misses ? (f64)hits / (f64)(hits + misses) : 0.0; }
+};
+
+// DFA built from subsets of the Nfa while scanning. States live in a cache of
+// at most cache_bytes and the whole cache is flushed when it fills up.
+struct LazyDfa {
+    const Nfa* nfa;
+    size_t cache_bytes;
+    i32 max_states;
+    i32 num_states;
+    std::vector<u64> sets;    // [state][num_words]
+    std::vector<u32> trans;   // [state][num_classes]
+    std::vector<u32> slots;   // open addressing over sets
+    LazyDfaStats stats;
+
+    void flush();
+    void scan(std::string_view input, u64* set);
+    bool accepts(std::string_view input);
+
+    u32 intern(const u64* set);
+    u32 find_or_add(const u64* set);
+};
+
+LazyDfa MakeLazyDfa(const Nfa& nfa, size_t cache_bytes = LAZY_DFA_DEFAULT_CACHE);
+
+#endif
@@ -0,0 +1,230 @@
+#include "minimize.h"
+#include <chrono>
+#include "shuffle_dfa.h"
+
+// Blocks are ranges of elems; the marked members of a block are moved to the
+// front of its range while a splitter is processed.
+struct Partition {
+    std::vector<u32> elems;
+    std::vector<u32> pos;       // index of every state in elems
+    std::vector<u32> block_of;
+    std::vector<u32> first;
+    std::vector<u32> end;
+    std::vector<u32> marked;    // marked members of every block
+
+    u32 size(u32 b) const { return end[b] - first[b]; }
+
+    void mark(u32 s)
+    {
+        u32 b = block_of[s];
+        u32 target = first[b] + marked[b]++;
+        u32 other = elems[target];
+        elems[pos[s]] = other;
+        pos[other] = pos[s];
+        elems[target] = s;
+        pos[s] = target;
+    }
+
+    // Splits off the marked part of b as a new block and returns its id.
+    u32 split(u32 b)
+    {
+        u32 nb = (u32)first.size();
+        first.push_back(first[b]);
+        end.push_back(first[b] + marked[b]);
+        marked.push_back(0);
+        first[b] += marked[b];
+        marked[b] = 0;
+        for (u32 i = first[nb]; i < end[nb]; i++) block_of[elems[i]] = nb;
+        return nb;
+    }
+};
+
+Automaton Minimize(const Automaton& dfa, MinimizeStats* stats)
+{
+    auto begin = std::chrono::steady_clock::now();
+
+    std::array<u8, ALPHABET_SIZE> byte_class;
+    i32 k = ComputeByteClasses(dfa, byte_class);
+    std::vector<i32> class_byte(k, -1);
+    for (i32 b = 0; b < ALPHABET_SIZE; b++)
+    {
+        if (class_byte[byte_class[b]] < 0) class_byte[byte_class[b]] = b;
+    }
+
+
+    // Reachable states, renumbered densely with the sink kept at 0.
+    std::vector<u32> dense(dfa.num_states, 0xFFFFFFFF);
+    std::vector<u32> original;
+    dense[DEAD_STATE] = 0;
+    original.push_back(DEAD_STATE);
+    if (dense[dfa.start] == 0xFFFFFFFF)
+    {
+        dense[dfa.start] = (u32)original.size();
+        original.push_back(dfa.start);
+    }
+    for (size_t i = 0; i < original.size(); i++)
+    {
+        for (i32 c = 0; c < k; c++)
+        {
+            u32 t = dfa.next(original[i], (u8)class_byte[c]);
+            if (dense[t] != 0xFFFFFFFF) continue;
+            dense[t] = (u32)original.size();
+            original.push_back(t);
+        }
+    }
+    u32 n = (u32)original.size();
+
+    // Class compressed transitions of the reachable part.
+    std::vector<u32> succ((size_t)n * k);
+    for (u32 s = 0; s < n; s++)
+    {
+        for (i32 c = 0; c < k; c++) succ[(size_t)s * k + c] = dense[dfa.next(original[s], (u8)class_byte[c])];
+    }
+
+    // Predecessors per class in CSR form: inv_start[c * (n + 1) + t].
+    std::vector<u32> inv_start((size_t)k * (n + 1), 0);
+    std::vector<u32> inv((size_t)k * n);
+    for (u32 s = 0; s < n; s++)
+    {
+        for (i32 c = 0; c < k; c++) inv_start[(size_t)c * (n + 1) + succ[(size_t)s * k + c] + 1]++;
+    }
+    for (i32 c = 0; c < k; c++)
+    {
+        u32* row = &inv_start[(size_t)c * (n + 1)];
+        for (u32 t = 0; t < n; t++) row[t + 1] += row[t];
+    }
+    {
+        std::vector<u32> fill(inv_start);
+        for (i32 c = 0; c < k; c++)
+        {
+            for (u32 s = 0; s < n; s++)
+            {
+                u32 t = succ[(size_t)s * k + c];
+                inv[(size_t)c * n + fill[(size_t)c * (n + 1) + t]++] = s;
+            }
+        }
+    }
+
+    // Initial partition: rejecting, accepting.
+    Partition part;
+    part.elems.resize(n);
+    part.pos.resize(n);
+    part.block_of.resize(n);
+    u32 num_rejecting = 0;
+    for (u32 s = 0; s < n; s++) if (!dfa.is_accepting(original[s])) num_rejecting++;
+    u32 lo = 0, hi = num_rejecting;
+    for (u32 s = 0; s < n; s++)
+    {
+        bool acc = dfa.is_accepting(original[s]);
+        u32 p = acc ? hi++ : lo++;
+        part.elems[p] = s;
+        part.pos[s] = p;
+        part.block_of[s] = acc ? 1 : 0;
+    }
+    part.first = {0, num_rejecting};
+    part.end = {num_rejecting, n};
+    part.marked = {0, 0};
+    if (num_rejecting == n)
+    {
+        part.first.pop_back();
+        part.end.pop_back();
+        part.marked.pop_back();
+    }
+
+    std::vector<bool> in_work;
+    std::vector<std::pair<u32, i32>> work;
+    auto push = [&](u32 b, i32 c) {
+        size_t key = (size_t)b * k + c;
+        if (in_work.size() <= key) in_work.resize((size_t)(b + 1) * k * 2, false);
+        if (in_work[key]) return;
+        in_work[key] = true;
+        work.push_back({b, c});
+    };
+    u32 smaller = part.first.size() == 2 && part.size(1) < part.size(0) ? 1 : 0;
+    for (i32 c = 0; c < k; c++) push(smaller, c);
+
+    std::vector<u32> preds;
+    std::vector<u32> touched;
+    while (!work.empty())
+    {
+        auto [splitter, c] = work.back();
+        work.pop_back();
+        in_work[(size_t)splitter * k + c] = false;
+
+        preds.clear();
+        const u32* start = &inv_start[(size_t)c * (n + 1)];
+        const u32* edges = &inv[(size_t)c * n];
+        for (u32 i = part.first[splitter]; i < part.end[splitter]; i++)
+        {
+            u32 t = part.elems[i];
+            preds.insert(preds.end(), edges + start[t], edges + start[t + 1]);
+        }
+
+        touched.clear();
+        for (u32 p: preds)
+        {
+            u32 b = part.block_of[p];
+            if (part.pos[p] < part.first[b] + part.marked[b]) continue;
+            if (part.marked[b] == 0) touched.push_back(b);
+            part.mark(p);
+        }
+
+        for (u32 b: touched)
+        {
+            if (part.marked[b] == part.size(b))
+            {
+                part.marked[b] = 0;
+                continue;
+            }
+            u32 nb = part.split(b);
+            for (i32 a = 0; a < k; a++)
+            {
+                size_t key = (size_t)b * k + a;
+                if (key < in_work.size() && in_work[key]) push(nb, a);
+                else push(part.size(nb) < part.size(b) ? nb : b, a);
+            }
+        }
+    }
+
+    // One state per block, sink block first and accepting blocks last.
+    u32 blocks = (u32)part.first.size();
+    std::vector<u32> order(blocks, 0xFFFFFFFF);
+    Automaton out = {};
+    out.num_states = (i32)blocks;
+    u32 next_id = 0;
+    order[part.block_of[0]] = next_id++;
+    for (i32 pass = 0; pass < 2; pass++)
+    {
+        if (pass == 1) out.accept_base = next_id;
+        for (u32 b = 0; b < blocks; b++)
+        {
+            if (order[b] != 0xFFFFFFFF) continue;
+            if (dfa.is_accepting(original[part.elems[part.first[b]]]) != (pass == 1)) continue;
+            order[b] = next_id++;
+        }
+    }
+
+    out.start = order[part.block_of[dense[dfa.start]]];
+    out.init_table(byte_class, k);
+    out.node_ids.assign(blocks, 0);
+    for (u32 b = 0; b < blocks; b++)
+    {
+        u32 s = part.elems[part.first[b]];
+        u32 id = order[b];
+        out.node_ids[id] = dfa.node_ids.empty() ? 0 : dfa.node_ids[original[s]];
+        for (i32 c = 0; c < k; c++) out.entry(id, c) = order[part.block_of[succ[(size_t)s * k + c]]];
+    }
+    out.node_ids[0] = 0;
+    AttachShuffleDfa(out);
+
+    if (stats)
+    {
+        stats->states_before = dfa.num_states;
+        stats->states_after = out.num_states;
+        stats->num_classes = k;
+        stats->ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - begin).count();
+        stats->bytes = sizeof(u32) * (dense.size() + original.size() + succ.size() + inv_start.size() + inv.size() + preds.capacity())
+                     + sizeof(u32) * 3 * n + sizeof(u32) * 3 * blocks + in_work.size() / 8;
+    }
+    return out;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#ifndef MINIMIZE
+#define MINIMIZE
+
+#include "../vstd/vtypes.h"
+#include "automaton.h"
+
+struct MinimizeStats {
+    i32 states_before;
+    i32 states_after;
+    i32 num_classes;
+    f64 ms;
+    size_t bytes;  // working memory, the input and output tables excluded
+};
+
+// Hopcroft partition refinement. Unreachable states are dropped first and
+// bytes with identical columns are refined together as one class.
+Automaton Minimize(const Automaton& dfa, MinimizeStats* stats = nullptr);
+
+#endif
@@ -0,0 +1,267 @@
+#include "nfa.h"
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+constexpr size_t NFA_SCAN_BLOCK = 64;
+
+// Row s holds every state reachable from s by empty moves, s included.
+// Empty when the canvas has no empty moves at all.
+// Tarjan's algorithm emits the strongly connected components of the empty
+// moves sinks first, so each component's closure is its own members OR'd
+// with the already finished closures of the components it points to, and
+// every state of a cycle shares one row.
+static std::vector<u64> EpsilonClosures(const CanvasCsr& csr, i32 words)
+{
+    // Empty moves sort first, so those of s are [offsets[s], empty_end[s]).
+    i32 states = csr.num_states;
+    std::vector<u32> empty_end(states);
+    bool any = false;
+    for (i32 s = 0; s < states; s++)
+    {
+        u32 e = csr.offsets[s];
+        while (e < csr.offsets[s + 1] && csr.arcs[e].label == CSR_EPSILON) e++;
+        empty_end[s] = e;
+        any |= e != csr.offsets[s];
+    }
+
+    std::vector<u64> closure;
+    if (!any) return closure;
+
+    closure.assign((size_t)states * words, 0);
+    for (i32 s = 0; s < states; s++) BitsetSet(&closure[(size_t)s * words], s);
+
+    std::vector<i32> index(states, -1), low(states, 0), component(states, -1);
+    std::vector<u32> member_pos(states, 0);  // where a state sits on members
+    std::vector<i32> members, call;  // call holds (state, next arc) pairs
+    std::vector<u64> row(words);
+    i32 counter = 0;
+    for (i32 root = 0; root < states; root++)
+    {
+        if (index[root] >= 0 || empty_end[root] == csr.offsets[root]) continue;
+        call.push_back(root);
+        call.push_back(0);
+        index[root] = low[root] = counter++;
+        member_pos[root] = (u32)members.size();
+        members.push_back(root);
+        while (!call.empty())
+        {
+            i32 s = call[call.size() - 2];
+            i32& next = call.back();
+            if (csr.offsets[s] + next < empty_end[s])
+            {
+                i32 to = csr.arcs[csr.offsets[s] + next++].to;
+                if (index[to] < 0)
+                {
+                    index[to] = low[to] = counter++;
+                    member_pos[to] = (u32)members.size();
+                    members.push_back(to);
+                    call.push_back(to);
+                    call.push_back(0);
+                }
+                else if (component[to] < 0) low[s] = std::min(low[s], index[to]);
+                continue;
+            }
+
+            call.resize(call.size() - 2);
+            if (!call.empty())
+            {
+                i32 parent = call[call.size() - 2];
+                low[parent] = std::min(low[parent], low[s]);
+            }
+            if (low[s] != index[s]) continue;
+
+            // s roots a component: everything above it on members.
+            size_t first = member_pos[s];
+            std::fill(row.begin(), row.end(), 0);
+            for (size_t m = first; m < members.size(); m++) component[members[m]] = s;
+            for (size_t m = first; m < members.size(); m++)
+            {
+                i32 member = members[m];
+                BitsetSet(row.data(), member);
+                for (u32 e = csr.offsets[member]; e < empty_end[member]; e++)
+                {
+                    i32 to = csr.arcs[e].to;
+                    if (component[to] == s) continue;
+                    const u64* other = &closure[(size_t)to * words];
+                    for (i32 w = 0; w < words; w++) row[w] |= other[w];
+                }
+            }
+            for (size_t m = first; m < members.size(); m++)
+            {
+                memcpy(&closure[(size_t)members[m] * words], row.data(), sizeof(u64) * words);
+            }
+            members.resize(first);
+        }
+    }
+    return closure;
+}
+
+Nfa CompileNfa(const CanvasCsr& csr)
+{
+    Nfa nfa = {};
+
+    nfa.node_ids = csr.node_ids;
+    nfa.num_states = csr.num_states;
+    nfa.num_words = BitsetWords(nfa.num_states > 0 ? nfa.num_states : 1);
+
+    nfa.initial.assign(nfa.num_words, 0);
+    nfa.accepting.assign(nfa.num_words, 0);
+    for (i32 s = 0; s < nfa.num_states; s++)
+    {
+        NODE_KIND kind = csr.kind[s];
+        if (IsInitial(kind)) BitsetSet(nfa.initial.data(), s);
+        if (IsAccepting(kind)) BitsetSet(nfa.accepting.data(), s);
+    }
+
+    // Empty moves are folded away: the initial set and every successor row
+    // are closed under them, so step never has to follow one.
+    std::vector<u64> closure = EpsilonClosures(csr, nfa.num_words);
+    std::vector<u64> closed(nfa.num_words);
+    auto close = [&](u64* set) {
+        if (closure.empty()) return;
+        std::fill(closed.begin(), closed.end(), 0);
+        for (i32 w = 0; w < nfa.num_words; w++)
+        {
+            for (u64 bits = set[w]; bits; bits &= bits - 1)
+            {
+                const u64* row = &closure[(size_t)(w * 64 + CountTrailingZeros(bits)) * nfa.num_words];
+                for (i32 k = 0; k < nfa.num_words; k++) closed[k] |= row[k];
+            }
+        }
+        memcpy(set, closed.data(), sizeof(u64) * nfa.num_words);
+    };
+    close(nfa.initial.data());
+
+    // Canvas classes labelling the same (from, to) pairs are merged. Classes
+    // no arc reads fall into class 0, which has no successors; when every
+    // class is used class 0 is a regular class so 256 classes still fit in
+    // a u8. Rows are walked in state order and are free of duplicates, so
+    // every list comes out sorted and unique.
+    std::vector<std::vector<u64>> pairs(csr.num_classes);
+    for (i32 s = 0; s < csr.num_states; s++)
+    {
+        for (const CsrArc* a = csr.begin(s); a != csr.end(s); a++)
+        {
+            if (a->label != CSR_EPSILON) pairs[a->label].push_back((u64)s << 32 | (u32)a->to);
+        }
+    }
+    std::map<std::vector<u64>, u8> class_of;
+    for (i32 c = 0; c < csr.num_classes; c++)
+    {
+        if (pairs[c].empty()) class_of[pairs[c]] = 0;
+    }
+    nfa.num_classes = (i32)class_of.size();
+    std::vector<u8> merged(csr.num_classes);
+    for (i32 c = 0; c < csr.num_classes; c++)
+    {
+        auto it = class_of.find(pairs[c]);
+        if (it == class_of.end()) it = class_of.emplace(pairs[c], (u8)nfa.num_classes++).first;
+        merged[c] = it->second;
+    }
+    for (i32 b = 0; b < ALPHABET_SIZE; b++) nfa.byte_class[b] = merged[csr.byte_class[b]];
+
+    // Successor rows per state first, the single word case is folded into
+    // nibble tables afterwards.
+    std::vector<u64> rows((size_t)nfa.num_classes * nfa.num_states * nfa.num_words, 0);
+    for (i32 s = 0; s < csr.num_states; s++)
+    {
+        for (const CsrArc* a = csr.begin(s); a != csr.end(s); a++)
+        {
+            if (a->label == CSR_EPSILON) continue;
+            size_t row = (size_t)merged[a->label] * nfa.num_states + s;
+            BitsetSet(&rows[row * nfa.num_words], a->to);
+        }
+    }
+    for (size_t row = 0; row < (size_t)nfa.num_classes * nfa.num_states; row++) close(&rows[row * nfa.num_words]);
+
+    if (nfa.num_words > 1)
+    {
+        nfa.succ = std::move(rows);
+        return nfa;
+    }
+
+    i32 chunks = nfa.num_chunks();
+    nfa.succ.assign((size_t)nfa.num_classes * chunks * NFA_CHUNK_SIZE, 0);
+    for (i32 cls = 0; cls < nfa.num_classes; cls++)
+    {
+        u64* t = &nfa.succ[(size_t)cls * chunks * NFA_CHUNK_SIZE];
+        const u64* r = &rows[(size_t)cls * nfa.num_states];
+        for (i32 c = 0; c < chunks; c++)
+        {
+            for (i32 pattern = 1; pattern < NFA_CHUNK_SIZE; pattern++)
+            {
+                u64 out = 0;
+                for (i32 b = 0; b < NFA_CHUNK_BITS; b++)
+                {
+                    i32 s = c * NFA_CHUNK_BITS + b;
+                    if ((pattern >> b) & 1 && s < nfa.num_states) out |= r[s];
+                }
+                t[c * NFA_CHUNK_SIZE + pattern] = out;
+            }
+        }
+    }
+    return nfa;
+}
+
+void Nfa::step(const u64* in, u8 byte, u64* out) const
+{
+    if (num_words == 1)
+    {
+        out[0] = step(in[0], byte);
+        return;
+    }
+
+    memset(out, 0, sizeof(u64) * num_words);
+    const u64* t = &succ[(size_t)byte_class[byte] * num_states * num_words];
+    for (i32 w = 0; w < num_words; w++)
+    {
+        u64 bits = in[w];
+        while (bits)
+        {
+            i32 s = w * 64 + CountTrailingZeros(bits);
+            bits &= bits - 1;
+            const u64* row = &t[(size_t)s * num_words];
+            for (i32 k = 0; k < num_words; k++) out[k] |= row[k];
+        }
+    }
+}
+
+void Nfa::scan(std::string_view input, u64* set) const
+{
+    const u8* p = (const u8*)input.data();
+    const u8* end = p + input.size();
+
+    if (num_words == 1)
+    {
+        u64 s = set[0];
+        while ((size_t)(end - p) >= NFA_SCAN_BLOCK)
+        {
+            for (size_t i = 0; i < NFA_SCAN_BLOCK; i++) s = step(s, p[i]);
+            p += NFA_SCAN_BLOCK;
+            if (!s) break;
+        }
+        while (p < end && s) s = step(s, *p++);
+        set[0] = s;
+        return;
+    }
+
+    std::vector<u64> tmp(num_words);
+    u64* cur = set;
+    u64* next = tmp.data();
+    while (p < end && BitsetAny(cur, num_words))
+    {
+        step(cur, *p++, next);
+        u64* swap = cur;
+        cur = next;
+        next = swap;
+    }
+    if (cur != set) memcpy(set, cur, sizeof(u64) * num_words);
+}
+
+bool Nfa::accepts(std::string_view input) const
+{
+    std::vector<u64> set = initial;
+    scan(input, set.data());
+    return is_accepting(set.data());
+}
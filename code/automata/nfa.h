@@ -0,0 +1,54 @@
+#pragma once
+#ifndef NFA
+#define NFA
+
+#include <string_view>
+#include <vector>
+#include "../graph.h"
+#include "../vstd/vtypes.h"
+#include "automaton.h"
+#include "bitset.h"
+#include "csr.h"
+
+constexpr i32 NFA_CHUNK_BITS = 4;
+constexpr i32 NFA_CHUNK_SIZE = 1 << NFA_CHUNK_BITS;
+
+// Bit-parallel NFA over the canvas. Bytes that label the same arcs share a
+// class, and every class has its own successor table:
+//   one word:  [class][nibble][16]        -> step is a fixed OR of lookups
+//   more:      [class][state][num_words]  -> step ORs the rows of set bits
+struct Nfa {
+    i32 num_states;
+    i32 num_words;
+    i32 num_classes;
+    std::array<u8, ALPHABET_SIZE> byte_class;
+    std::vector<u64> succ;
+    std::vector<u64> initial;
+    std::vector<u64> accepting;
+    std::vector<i32> node_ids;  // canvas node of every state
+
+    i32 num_chunks() const { return (num_states + NFA_CHUNK_BITS - 1) / NFA_CHUNK_BITS; }
+
+    u64 step(u64 set, u8 byte) const
+    {
+        const u64* t = &succ[(size_t)byte_class[byte] * num_chunks() * NFA_CHUNK_SIZE];
+        u64 out = 0;
+        for (i32 c = 0; c < num_chunks(); c++)
+        {
+            out |= t[c * NFA_CHUNK_SIZE + ((set >> (c * NFA_CHUNK_BITS)) & (NFA_CHUNK_SIZE - 1))];
+        }
+        return out;
+    }
+
+    // out must not alias in; both hold num_words words.
+    void step(const u64* in, u8 byte, u64* out) const;
+
+    // Runs input over set in place.
+    void scan(std::string_view input, u64* set) const;
+    bool is_accepting(const u64* set) const { return BitsetIntersects(set, accepting.data(), num_words); }
+    bool accepts(std::string_view input) const;
+};
+
+Nfa CompileNfa(const CanvasCsr& csr);
+
+#endif
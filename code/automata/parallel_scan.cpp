@@ -0,0 +1,292 @@
+#include "parallel_scan.h"
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include "shuffle_dfa.h"
+
+constexpr size_t FUSION_MIN_INTERVAL = 64;
+constexpr size_t FUSION_MAX_INTERVAL = 1 << 16;
+
+static i32 ThreadCount(std::string_view input, i32 num_threads)
+{
+    if (num_threads <= 0) num_threads = (i32)std::thread::hardware_concurrency();
+    size_t most = input.size() / PARALLEL_SCAN_MIN_CHUNK;
+    if ((size_t)num_threads > most) num_threads = (i32)most;
+    return num_threads < 1 ? 1 : num_threads;
+}
+
+static std::string_view Chunk(std::string_view input, i32 idx, i32 count)
+{
+    size_t begin = input.size() * idx / count;
+    size_t end = input.size() * (idx + 1) / count;
+    return input.substr(begin, end - begin);
+}
+
+// map[s] = state reached after chunk when starting in s. Starting paths that
+// meet in the same state are merged and from then on run as one.
+static void RunFromAllStates(const Automaton& dfa, std::string_view chunk, std::vector<u32>& map)
+{
+    i32 n = dfa.num_states;
+    map.resize(n);
+
+    if (dfa.shuffle)
+    {
+        alignas(16) u8 lanes[SHUFFLE_DFA_LANES];
+        for (i32 i = 0; i < SHUFFLE_DFA_LANES; i++) lanes[i] = (u8)i;
+        dfa.shuffle->run(chunk, lanes);
+        for (i32 s = 0; s < n; s++) map[s] = lanes[s];
+        return;
+    }
+
+    std::vector<u32> active(n);
+    std::vector<u32> owner(n);
+    std::vector<i32> slot(n, -1);
+    std::vector<u32> remap;
+    std::iota(active.begin(), active.end(), 0);
+    std::iota(owner.begin(), owner.end(), 0);
+
+    size_t interval = FUSION_MIN_INTERVAL;
+    size_t pos = 0;
+    while (pos < chunk.size())
+    {
+        size_t len = active.size() == 1 ? chunk.size() - pos : std::min(interval, chunk.size() - pos);
+        std::string_view block = chunk.substr(pos, len);
+        for (auto& s: active) s = dfa.scan(block, s);
+        pos += len;
+
+        size_t before = active.size();
+        remap.resize(before);
+        size_t after = 0;
+        for (size_t i = 0; i < before; i++)
+        {
+            u32 s = active[i];
+            if (slot[s] < 0)
+            {
+                slot[s] = (i32)after;
+                active[after++] = s;
+            }
+            remap[i] = (u32)slot[s];
+        }
+        active.resize(after);
+        for (auto s: active) slot[s] = -1;
+
+        if (after < before)
+        {
+            for (auto& o: owner) o = remap[o];
+        }
+        else if (interval < FUSION_MAX_INTERVAL)
+        {
+            interval *= 2;
+        }
+    }
+    for (i32 s = 0; s < n; s++) map[s] = active[owner[s]];
+}
+
+// Runs phase one and returns the real start state of every chunk.
+static std::vector<u32> ChunkStarts(const Automaton& dfa, std::string_view input, u32 state, i32 threads)
+{
+    std::vector<std::vector<u32>> maps(threads);
+    std::vector<u32> starts(threads + 1);
+    starts[0] = state;
+
+    // Errors are kept per chunk and rethrown once every worker is joined.
+    std::vector<std::exception_ptr> errors(threads);
+    auto run = [&](i32 i) {
+        try
+        {
+            if (i == 0) starts[1] = dfa.scan(Chunk(input, 0, threads), state);
+            else RunFromAllStates(dfa, Chunk(input, i, threads), maps[i]);
+        }
+        catch (...)
+        {
+            errors[i] = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    i32 started = 1;
+    try
+    {
+        for (; started < threads; started++) workers.emplace_back(run, started);
+    }
+    catch (...)
+    {
+        // Out of threads or memory: the chunks that got no thread run on
+        // this one.
+    }
+    run(0);
+    for (i32 i = started; i < threads; i++) run(i);
+    for (auto& w: workers) w.join();
+    for (auto& error: errors)
+    {
+        if (error) std::rethrow_exception(error);
+    }
+
+    for (i32 i = 1; i < threads; i++)
+    {
+        starts[i + 1] = maps[i][starts[i]];
+    }
+    return starts;
+}
+
+u32 ParallelScan(const Automaton& dfa, std::string_view input, u32 state, i32 num_threads)
+{
+    i32 threads = ThreadCount(input, num_threads);
+    if (threads == 1) return dfa.scan(input, state);
+    return ChunkStarts(dfa, input, state, threads)[threads];
+}
+
+bool ParallelAccepts(const Automaton& dfa, std::string_view input, i32 num_threads)
+{
+    return dfa.is_accepting(ParallelScan(dfa, input, dfa.start, num_threads));
+}
+
+// Matches of one chunk on their way to the calling thread. The worker fills
+// pending and swaps it into ready once the caller has taken the last batch,
+// so a chunk never holds more than two batches however many matches it has.
+struct MatchChannel {
+    std::mutex lock;
+    std::condition_variable changed;
+    std::vector<u64> pending;
+    std::vector<u64> ready;
+    bool full;       // ready holds a batch the caller has not taken
+    bool finished;   // nothing more will be sent
+    bool abandoned;  // the caller stopped reading, batches are dropped
+    bool on_caller;  // no thread could be started, the caller scans it
+    std::exception_ptr error;  // the worker threw, raised after its matches
+};
+
+static void HandOver(MatchChannel& channel, bool last)
+{
+    {
+        std::unique_lock<std::mutex> guard(channel.lock);
+        channel.changed.wait(guard, [&]() { return !channel.full || channel.abandoned; });
+        if (!channel.abandoned)
+        {
+            std::swap(channel.pending, channel.ready);
+            channel.full = !channel.ready.empty();
+        }
+        channel.pending.clear();
+        channel.finished = last;
+    }
+    channel.changed.notify_all();
+}
+
+static void SendMatch(u64 end_offset, void* user)
+{
+    MatchChannel& channel = *(MatchChannel*)user;
+    channel.pending.push_back(end_offset);
+    if (channel.pending.size() == PARALLEL_MATCH_BATCH) HandOver(channel, false);
+}
+
+// Reports the chunks in order, each as its batches arrive. Chunks left on
+// the caller are scanned here, straight into callback.
+static void Deliver(const Automaton& dfa, std::string_view input, const std::vector<u32>& starts, u64 base_offset,
+                    std::vector<MatchChannel>& channels, MatchCallback callback, void* user)
+{
+    i32 threads = (i32)channels.size();
+    std::vector<u64> batch;
+    batch.reserve(PARALLEL_MATCH_BATCH);
+    for (i32 i = 0; i < threads; i++)
+    {
+        MatchChannel& channel = channels[i];
+        if (channel.on_caller)
+        {
+            size_t begin = input.size() * i / threads;
+            dfa.find_matches(Chunk(input, i, threads), starts[i], base_offset + begin, callback, user);
+            continue;
+        }
+
+        std::exception_ptr error;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> guard(channel.lock);
+                channel.changed.wait(guard, [&]() { return channel.full || channel.finished; });
+                if (!channel.full)
+                {
+                    error = channel.error;
+                    break;
+                }
+                std::swap(channel.ready, batch);
+                channel.full = false;
+            }
+            channel.changed.notify_all();
+            for (u64 offset: batch) callback(offset, user);
+            batch.clear();
+        }
+        if (error) std::rethrow_exception(error);
+    }
+}
+
+u32 ParallelFindMatches(const Automaton& dfa, std::string_view input, u32 state, u64 base_offset,
+                        MatchCallback callback, void* user, i32 num_threads)
+{
+    i32 threads = ThreadCount(input, num_threads);
+    if (threads == 1) return dfa.find_matches(input, state, base_offset, callback, user);
+
+    // Phase two rescans every chunk from its now known start state.
+    std::vector<u32> starts = ChunkStarts(dfa, input, state, threads);
+    std::vector<MatchChannel> channels(threads);
+    auto run = [&](i32 i) {
+        MatchChannel& channel = channels[i];
+        try
+        {
+            size_t begin = input.size() * i / threads;
+            dfa.find_matches(Chunk(input, i, threads), starts[i], base_offset + begin, SendMatch, &channel);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> guard(channel.lock);
+            channel.error = std::current_exception();
+        }
+        HandOver(channel, true);
+    };
+
+    std::vector<std::thread> workers;
+    i32 next = 0;
+    try
+    {
+        for (; next < threads; next++)
+        {
+            MatchChannel& channel = channels[next];
+            channel.finished = starts[next] == DEAD_STATE;
+            if (channel.finished) continue;
+            channel.pending.reserve(PARALLEL_MATCH_BATCH);
+            channel.ready.reserve(PARALLEL_MATCH_BATCH);
+            workers.emplace_back(run, next);
+        }
+    }
+    catch (...)
+    {
+        // Out of threads or memory: the chunks that got no thread are
+        // scanned by Deliver.
+        for (; next < threads; next++)
+        {
+            channels[next].finished = starts[next] == DEAD_STATE;
+            channels[next].on_caller = !channels[next].finished;
+        }
+    }
+
+    try
+    {
+        Deliver(dfa, input, starts, base_offset, channels, callback, user);
+    }
+    catch (...)
+    {
+        // A throwing callback must not leave workers waiting for a reader.
+        for (auto& channel: channels)
+        {
+            std::lock_guard<std::mutex> guard(channel.lock);
+            channel.abandoned = true;
+            channel.changed.notify_all();
+        }
+        for (auto& w: workers) w.join();
+        throw;
+    }
+    for (auto& w: workers) w.join();
+    return starts[threads];
+}
@@ -0,0 +1,29 @@
+#pragma once
+#ifndef PARALLEL_SCAN
+#define PARALLEL_SCAN
+
+#include <string_view>
+#include <vector>
+#include "../vstd/vtypes.h"
+#include "automaton.h"
+
+// Inputs smaller than this per thread are scanned serially.
+constexpr size_t PARALLEL_SCAN_MIN_CHUNK = 1 << 20;
+// Matches a chunk passes to the calling thread at a time.
+constexpr size_t PARALLEL_MATCH_BATCH = 4096;
+
+// Splits input into one chunk per thread and runs every chunk from all states
+// at once, merging paths as soon as they reach the same state. The per chunk
+// state maps are then chained from the real start state, so the result is the
+// same as Automaton::scan. num_threads == 0 uses every hardware thread.
+u32 ParallelScan(const Automaton& dfa, std::string_view input, u32 state, i32 num_threads = 0);
+bool ParallelAccepts(const Automaton& dfa, std::string_view input, i32 num_threads = 0);
+
+// Same matches, in the same order, as Automaton::find_matches. callback runs
+// on the calling thread while the chunks are still being scanned; a chunk
+// waits once it has two batches the caller has not reported yet, so memory
+// does not grow with the number of matches.
+u32 ParallelFindMatches(const Automaton& dfa, std::string_view input, u32 state, u64 base_offset,
+                        MatchCallback callback, void* user, i32 num_threads = 0);
+
+#endif
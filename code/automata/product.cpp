@@ -0,0 +1,236 @@
+#include "product.h"
+#include <algorithm>
+#include <stdexcept>
+#include "shuffle_dfa.h"
+
+constexpr u32 PRODUCT_EMPTY_SLOT = 0xFFFFFFFF;
+constexpr u32 PRODUCT_UNKNOWN = 0xFFFFFFFF;
+constexpr size_t PRODUCT_MIN_SLOTS = 64;
+
+static u64 HashPair(u64 key)
+{
+    key *= 0x9E3779B97F4A7C15ull;
+    return key ^ (key >> 29);
+}
+
+LazyProduct MakeLazyProduct(const Nfa& a, const Nfa& b, PRODUCT_OP op)
+{
+    LazyProduct product = {};
+    product.op = op;
+    product.a = MakeSubsetSpace(a);
+    product.b = MakeSubsetSpace(b);
+    product.slots.assign(PRODUCT_MIN_SLOTS, PRODUCT_EMPTY_SLOT);
+
+    std::vector<i32> joint((size_t)a.num_classes * b.num_classes, -1);
+    for (i32 byte = 0; byte < ALPHABET_SIZE; byte++)
+    {
+        i32& cls = joint[(size_t)a.byte_class[byte] * b.num_classes + b.byte_class[byte]];
+        if (cls < 0)
+        {
+            cls = product.num_classes++;
+            product.class_byte[cls] = (u8)byte;
+        }
+        product.byte_class[byte] = (u8)cls;
+    }
+    return product;
+}
+
+u32 LazyProduct::find_or_add(u32 sa, u32 sb)
+{
+    u64 key = (u64)sa << 32 | sb;
+    size_t mask = slots.size() - 1;
+    size_t slot = HashPair(key) & mask;
+    while (slots[slot] != PRODUCT_EMPTY_SLOT)
+    {
+        if (pairs[slots[slot]] == key) return slots[slot];
+        slot = (slot + 1) & mask;
+    }
+
+    u32 id = (u32)num_states++;
+    pairs.push_back(key);
+    trans.resize(trans.size() + num_classes, PRODUCT_UNKNOWN);
+    slots[slot] = id;
+
+    if ((size_t)num_states * 2 > slots.size())
+    {
+        slots.assign(slots.size() * 2, PRODUCT_EMPTY_SLOT);
+        mask = slots.size() - 1;
+        for (u32 s = 0; s < (u32)num_states; s++)
+        {
+            size_t i = HashPair(pairs[s]) & mask;
+            while (slots[i] != PRODUCT_EMPTY_SLOT) i = (i + 1) & mask;
+            slots[i] = s;
+        }
+    }
+    return id;
+}
+
+u32 LazyProduct::next(u32 state, u8 byte)
+{
+    u32 cached = trans[(size_t)state * num_classes + byte_class[byte]];
+    if (cached != PRODUCT_UNKNOWN) return cached;
+    u32 sa = a.next((u32)(pairs[state] >> 32), byte);
+    u32 sb = b.next((u32)pairs[state], byte);
+    u32 t = find_or_add(sa, sb);
+    trans[(size_t)state * num_classes + byte_class[byte]] = t;
+    return t;
+}
+
+bool LazyProduct::accepting(u32 state) const
+{
+    bool in_a = a.accepting((u32)(pairs[state] >> 32));
+    bool in_b = b.accepting((u32)pairs[state]);
+    switch (op)
+    {
+        case PRODUCT_INTERSECTION: return in_a && in_b;
+        case PRODUCT_UNION:        return in_a || in_b;
+        case PRODUCT_DIFFERENCE:   return in_a && !in_b;
+    }
+    return false;
+}
+
+bool LazyProduct::dead(u32 state) const
+{
+    bool empty_a = a.empty((u32)(pairs[state] >> 32));
+    bool empty_b = b.empty((u32)pairs[state]);
+    switch (op)
+    {
+        case PRODUCT_INTERSECTION: return empty_a || empty_b;
+        case PRODUCT_UNION:        return empty_a && empty_b;
+        case PRODUCT_DIFFERENCE:   return empty_a;
+    }
+    return true;
+}
+
+bool LazyProduct::accepts(std::string_view input)
+{
+    u32 s = start();
+    for (char c: input)
+    {
+        if (dead(s)) return false;
+        s = next(s, (u8)c);
+    }
+    return accepting(s);
+}
+
+size_t LazyProduct::bytes() const
+{
+    return a.bytes() + b.bytes() + sizeof(u64) * pairs.capacity() + sizeof(u32) * (trans.capacity() + slots.capacity());
+}
+
+bool ShortestAccepted(LazyProduct& product, std::string* word)
+{
+    u32 start = product.start();
+    std::vector<u32> parent(product.num_states, PRODUCT_UNKNOWN);
+    std::vector<u8> via(product.num_states, 0);
+    std::vector<u32> queue = {start};
+    parent[start] = start;
+
+    for (size_t head = 0; head < queue.size(); head++)
+    {
+        u32 s = queue[head];
+        if (product.accepting(s))
+        {
+            word->clear();
+            for (u32 i = s; i != start; i = parent[i]) *word += (char)via[i];
+            std::reverse(word->begin(), word->end());
+            return true;
+        }
+        if (product.dead(s)) continue;
+        for (i32 cls = 0; cls < product.num_classes; cls++)
+        {
+            u32 t = product.next(s, product.class_byte[cls]);
+            if (t >= parent.size())
+            {
+                parent.resize(product.num_states, PRODUCT_UNKNOWN);
+                via.resize(product.num_states, 0);
+            }
+            if (parent[t] != PRODUCT_UNKNOWN) continue;
+            parent[t] = s;
+            via[t] = product.class_byte[cls];
+            queue.push_back(t);
+        }
+    }
+    return false;
+}
+
+Automaton MaterializeProduct(LazyProduct& product)
+{
+    u32 start = product.start();
+    i32 classes = product.num_classes;
+    for (u32 s = 0; s < (u32)product.num_states; s++)
+    {
+        if (product.dead(s)) continue;
+        for (i32 cls = 0; cls < classes; cls++) product.next(s, product.class_byte[cls]);
+        if (product.num_states > PRODUCT_MAX_STATES)
+        {
+            throw std::runtime_error("PRODUCT ABORTED: MORE THAN " + std::to_string(PRODUCT_MAX_STATES) + " STATES");
+        }
+    }
+
+    // Pairs that can reach acceptance, by a backwards walk over the
+    // predecessor lists.
+    u32 total = (u32)product.num_states;
+    std::vector<u32> pred_start(total + 1, 0);
+    std::vector<u32> pred;
+    for (u32 s = 0; s < total; s++)
+    {
+        if (product.dead(s)) continue;
+        for (i32 cls = 0; cls < classes; cls++) pred_start[product.trans[(size_t)s * classes + cls] + 1]++;
+    }
+    for (u32 s = 0; s < total; s++) pred_start[s + 1] += pred_start[s];
+    pred.resize(pred_start[total]);
+    std::vector<u32> fill(pred_start.begin(), pred_start.end() - 1);
+    for (u32 s = 0; s < total; s++)
+    {
+        if (product.dead(s)) continue;
+        for (i32 cls = 0; cls < classes; cls++) pred[fill[product.trans[(size_t)s * classes + cls]]++] = s;
+    }
+
+    std::vector<bool> live(total, false);
+    std::vector<u32> stack;
+    for (u32 s = 0; s < total; s++)
+    {
+        if (product.accepting(s))
+        {
+            live[s] = true;
+            stack.push_back(s);
+        }
+    }
+    while (!stack.empty())
+    {
+        u32 s = stack.back();
+        stack.pop_back();
+        for (u32 i = pred_start[s]; i < pred_start[s + 1]; i++)
+        {
+            if (live[pred[i]]) continue;
+            live[pred[i]] = true;
+            stack.push_back(pred[i]);
+        }
+    }
+
+    // Renumber so the sink is 0 and accepting states come last.
+    std::vector<u32> order(total, DEAD_STATE);
+    Automaton dfa = {};
+    u32 next_id = 1;
+    for (i32 pass = 0; pass < 2; pass++)
+    {
+        if (pass == 1) dfa.accept_base = next_id;
+        for (u32 s = 0; s < total; s++)
+        {
+            if (live[s] && product.accepting(s) == (pass == 1)) order[s] = next_id++;
+        }
+    }
+
+    dfa.num_states = (i32)next_id;
+    dfa.start = order[start];
+    dfa.node_ids.assign(next_id, 0);
+    dfa.init_table(product.byte_class, classes);
+    for (u32 s = 0; s < total; s++)
+    {
+        if (order[s] == DEAD_STATE) continue;
+        for (i32 c = 0; c < classes; c++) dfa.entry(order[s], c) = order[product.trans[(size_t)s * classes + c]];
+    }
+    AttachShuffleDfa(dfa);
+    return dfa;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#ifndef PRODUCT
+#define PRODUCT
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../vstd/vtypes.h"
+#include "automaton.h"
+#include "subsets.h"
+
+constexpr i32 PRODUCT_MAX_STATES = 1 << 24;
+
+enum PRODUCT_OP { PRODUCT_INTERSECTION, PRODUCT_UNION, PRODUCT_DIFFERENCE };
+
+// Product of the subset automata of a and b, built one pair at a time as it
+// is reached. Bytes are grouped in the joint classes of both Nfas.
+struct LazyProduct {
+    PRODUCT_OP op;
+    SubsetSpace a;
+    SubsetSpace b;
+    i32 num_classes;
+    std::array<u8, ALPHABET_SIZE> byte_class;
+    std::array<u8, ALPHABET_SIZE> class_byte;  // lowest byte of every class
+    i32 num_states;
+    std::vector<u64> pairs;  // a set << 32 | b set
+    std::vector<u32> trans;  // [state][num_classes]
+    std::vector<u32> slots;  // open addressing over pairs
+
+    u32 start() { return find_or_add(a.initial(), b.initial()); }
+    u32 next(u32 state, u8 byte);
+    bool accepting(u32 state) const;
+    // No word leads from here to acceptance whatever the other side does.
+    bool dead(u32 state) const;
+    bool accepts(std::string_view input);
+    size_t bytes() const;
+
+    u32 find_or_add(u32 sa, u32 sb);
+};
+
+LazyProduct MakeLazyProduct(const Nfa& a, const Nfa& b, PRODUCT_OP op);
+
+// Breadth first until the first accepting pair. False when the language is
+// empty, otherwise word is set to a shortest member.
+bool ShortestAccepted(LazyProduct& product, std::string* word);
+
+// Dense automaton of the reachable part, with the pairs that cannot reach
+// acceptance folded into the sink. Throws past PRODUCT_MAX_STATES.
+Automaton MaterializeProduct(LazyProduct& product);
+
+#endif
@@ -0,0 +1,159 @@
+#include "reachability.h"
+#include <algorithm>
+
+// Both directions share the code: the forward pass walks out with
+// from_init as the parents, the backward pass walks in with to_goal.
+using Adjacency = std::vector<std::vector<i32>>;
+using Parents = std::vector<i32>;
+
+static void Propagate(const Adjacency& next, Parents& parent, std::vector<i32>& stack)
+{
+    while (!stack.empty())
+    {
+        i32 cur = stack.back();
+        stack.pop_back();
+        for (i32 to: next[cur])
+        {
+            if (parent[to] != REACH_NONE) continue;
+            parent[to] = cur;
+            stack.push_back(to);
+        }
+    }
+}
+
+// Unmarks cut and every node that was reached through it.
+static std::vector<i32> Detach(const Adjacency& next, Parents& parent, i32 cut)
+{
+    std::vector<i32> affected;
+    if (parent[cut] == REACH_NONE) return affected;
+    parent[cut] = REACH_NONE;
+    affected.push_back(cut);
+    for (size_t i = 0; i < affected.size(); i++)
+    {
+        for (i32 to: next[affected[i]])
+        {
+            if (parent[to] != affected[i]) continue;
+            parent[to] = REACH_NONE;
+            affected.push_back(to);
+        }
+    }
+    return affected;
+}
+
+// Anything detached that still has a marked neighbour is marked again
+// through it, the rest of the subtree follows from there.
+static void Reattach(const Adjacency& prev, const Adjacency& next, Parents& parent, const std::vector<i32>& affected)
+{
+    std::vector<i32> stack;
+    for (i32 id: affected)
+    {
+        for (i32 from: prev[id])
+        {
+            if (parent[from] == REACH_NONE) continue;
+            parent[id] = from;
+            stack.push_back(id);
+            break;
+        }
+    }
+    Propagate(next, parent, stack);
+}
+
+static void Unlink(std::vector<i32>& list, i32 id)
+{
+    list.erase(std::remove(list.begin(), list.end(), id), list.end());
+}
+
+void Reachability::rebuild(const CanvasCsr& csr)
+{
+    i32 slots = (i32)csr.state_of_node.size();
+    out.assign(slots, {});
+    in.assign(slots, {});
+    from_init.assign(slots, REACH_NONE);
+    to_goal.assign(slots, REACH_NONE);
+
+    std::vector<i32> forward, backward;
+    for (i32 s = 0; s < csr.num_states; s++)
+    {
+        i32 id = csr.node_ids[s];
+        for (const CsrArc* a = csr.begin(s); a != csr.end(s); a++)
+        {
+            out[id].push_back(csr.node_ids[a->to]);
+            in[csr.node_ids[a->to]].push_back(id);
+        }
+        if (IsInitial(csr.kind[s])) from_init[id] = REACH_ROOT, forward.push_back(id);
+        if (IsAccepting(csr.kind[s])) to_goal[id] = REACH_ROOT, backward.push_back(id);
+    }
+    Propagate(out, from_init, forward);
+    Propagate(in, to_goal, backward);
+}
+
+void Reachability::fit(i32 slots)
+{
+    if (slots <= (i32)out.size()) return;
+    out.resize(slots);
+    in.resize(slots);
+    from_init.resize(slots, REACH_NONE);
+    to_goal.resize(slots, REACH_NONE);
+}
+
+void Reachability::add_arc(i32 from, i32 to)
+{
+    fit(std::max(from, to) + 1);
+    out[from].push_back(to);
+    in[to].push_back(from);
+    if (reachable(from) && !reachable(to))
+    {
+        from_init[to] = from;
+        std::vector<i32> stack = {to};
+        Propagate(out, from_init, stack);
+    }
+    if (live(to) && !live(from))
+    {
+        to_goal[from] = to;
+        std::vector<i32> stack = {from};
+        Propagate(in, to_goal, stack);
+    }
+}
+
+void Reachability::change_kind(i32 id, NODE_KIND old_kind, NODE_KIND kind)
+{
+    fit(id + 1);
+    if (IsInitial(kind) && !IsInitial(old_kind))
+    {
+        bool was_reachable = reachable(id);
+        from_init[id] = REACH_ROOT;
+        std::vector<i32> stack = {id};
+        if (!was_reachable) Propagate(out, from_init, stack);
+    }
+    else if (!IsInitial(kind) && IsInitial(old_kind))
+    {
+        Reattach(in, out, from_init, Detach(out, from_init, id));
+    }
+
+    if (IsAccepting(kind) && !IsAccepting(old_kind))
+    {
+        bool was_live = live(id);
+        to_goal[id] = REACH_ROOT;
+        std::vector<i32> stack = {id};
+        if (!was_live) Propagate(in, to_goal, stack);
+    }
+    else if (!IsAccepting(kind) && IsAccepting(old_kind))
+    {
+        Reattach(out, in, to_goal, Detach(in, to_goal, id));
+    }
+}
+
+void Reachability::remove_node(i32 id)
+{
+    fit(id + 1);
+    std::vector<i32> forward = Detach(out, from_init, id);
+    std::vector<i32> backward = Detach(in, to_goal, id);
+
+    for (i32 to: out[id]) Unlink(in[to], id);
+    for (i32 from: in[id]) Unlink(out[from], id);
+    out[id].clear();
+    in[id].clear();
+
+    Reattach(in, out, from_init, forward);
+    Reattach(out, in, to_goal, backward);
+}
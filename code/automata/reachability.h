@@ -0,0 +1,36 @@
+#pragma once
+#ifndef REACHABILITY
+#define REACHABILITY
+
+#include <vector>
+#include "../graph.h"
+#include "csr.h"
+#include "../vstd/vtypes.h"
+
+constexpr i32 REACH_NONE = -1;
+constexpr i32 REACH_ROOT = 0;  // node 0 is never used, so it marks a root
+
+// Which canvas nodes are reachable from an INIT node and which can reach a
+// GOAL node, kept up to date edit by edit. Every reached node remembers the
+// neighbour it was reached through, so the reached nodes form a forest:
+// adding an arc only propagates from its endpoints, and removing a node or
+// a root only re-derives the subtree that hung from it.
+struct Reachability {
+    std::vector<std::vector<i32>> out;
+    std::vector<std::vector<i32>> in;
+    std::vector<i32> from_init;  // predecessor towards INIT
+    std::vector<i32> to_goal;    // successor towards GOAL
+
+    bool reachable(i32 id) const { return id < (i32)from_init.size() && from_init[id] != REACH_NONE; }
+    bool live(i32 id) const { return id < (i32)to_goal.size() && to_goal[id] != REACH_NONE; }
+
+    void rebuild(const CanvasCsr& csr);
+    // Makes room for ids added to the canvas since the last rebuild.
+    void fit(i32 slots);
+    void add_arc(i32 from, i32 to);
+    void change_kind(i32 id, NODE_KIND old_kind, NODE_KIND kind);
+    // Call before the node is cleared, its arcs are dropped here.
+    void remove_node(i32 id);
+};
+
+#endif
@@ -0,0 +1,350 @@
+#include "regex.h"
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include "bitset.h"
+
+enum REGEX_OP { RE_EMPTY, RE_BYTES, RE_CAT, RE_ALT, RE_STAR, RE_PLUS, RE_OPT };
+
+// Children are always created before their parent, so walking the nodes in
+// index order is a post-order walk.
+struct RegexNode {
+    REGEX_OP op;
+    i32 left;
+    i32 right;
+    i32 bytes;  // index into Parser::sets for RE_BYTES
+};
+
+struct Parser {
+    const std::string& pattern;
+    size_t pos;
+    i32 depth;
+    std::vector<RegexNode> nodes;
+    std::vector<ByteSet> sets;
+
+    [[noreturn]] void fail(const char* what)
+    {
+        throw std::runtime_error(std::string("INVALID REGEX: ") + what + " AT " + std::to_string(pos));
+    }
+
+    bool more() const { return pos < pattern.size(); }
+    char peek() const { return pattern[pos]; }
+
+    i32 add(REGEX_OP op, i32 left = -1, i32 right = -1, i32 bytes = -1)
+    {
+        nodes.push_back({op, left, right, bytes});
+        return (i32)nodes.size() - 1;
+    }
+
+    i32 add_bytes(const ByteSet& set)
+    {
+        sets.push_back(set);
+        return add(RE_BYTES, -1, -1, (i32)sets.size() - 1);
+    }
+
+    static i32 hex(char c)
+    {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    // Called just past a backslash.
+    u8 escaped()
+    {
+        if (!more()) fail("TRAILING BACKSLASH");
+        char c = pattern[pos++];
+        switch (c)
+        {
+            case 'n': return '\n';
+            case 't': return '\t';
+            case 'r': return '\r';
+            case 'x': {
+                if (pos + 2 > pattern.size() || hex(pattern[pos]) < 0 || hex(pattern[pos + 1]) < 0) fail("BAD \\x ESCAPE");
+                u8 byte = (u8)(hex(pattern[pos]) * 16 + hex(pattern[pos + 1]));
+                pos += 2;
+                return byte;
+            }
+        }
+        return (u8)c;
+    }
+
+    // Called just past '['.
+    i32 byte_class()
+    {
+        ByteSet set = {};
+        bool negate = more() && peek() == '^';
+        if (negate) pos++;
+        bool first = true;
+        while (true)
+        {
+            if (!more()) fail("UNTERMINATED [");
+            if (peek() == ']' && !first) break;
+            first = false;
+            u8 lo = peek() == '\\' ? (pos++, escaped()) : (u8)pattern[pos++];
+            u8 hi = lo;
+            if (pos + 1 < pattern.size() && peek() == '-' && pattern[pos + 1] != ']')
+            {
+                pos++;
+                hi = peek() == '\\' ? (pos++, escaped()) : (u8)pattern[pos++];
+                if (hi < lo) fail("BAD RANGE");
+            }
+            ByteSetAddRange(set, lo, hi);
+        }
+        pos++;
+        if (negate) for (auto& w: set) w = ~w;
+        return add_bytes(set);
+    }
+
+    i32 atom()
+    {
+        char c = pattern[pos++];
+        ByteSet set = {};
+        switch (c)
+        {
+            case '(': {
+                if (++depth > REGEX_MAX_DEPTH) fail("NESTED TOO DEEP");
+                i32 inner = alternation();
+                if (!more() || peek() != ')') fail("MISSING )");
+                pos++;
+                depth--;
+                return inner;
+            }
+            case '[': return byte_class();
+            case '.': {
+                ByteSetAddRange(set, 0, 255);
+                set['\n' >> 6] &= ~((u64)1 << ('\n' & 63));
+                return add_bytes(set);
+            }
+            case '\\': {
+                u8 byte = escaped();
+                ByteSetAddRange(set, byte, byte);
+                return add_bytes(set);
+            }
+            case '*': case '+': case '?': pos--; fail("NOTHING TO REPEAT");
+            case ')': pos--; fail("UNMATCHED )");
+        }
+        ByteSetAddRange(set, (u8)c, (u8)c);
+        return add_bytes(set);
+    }
+
+    i32 repetition()
+    {
+        i32 node = atom();
+        while (more() && (peek() == '*' || peek() == '+' || peek() == '?'))
+        {
+            char c = pattern[pos++];
+            REGEX_OP op = c == '*' ? RE_STAR : c == '+' ? RE_PLUS : RE_OPT;
+            // Stacked operators collapse, x** and x+? are x* and so on.
+            REGEX_OP inner = nodes[node].op;
+            if (inner == RE_STAR || inner == RE_PLUS || inner == RE_OPT)
+            {
+                if (op != inner) nodes[node].op = RE_STAR;
+                continue;
+            }
+            node = add(op, node);
+        }
+        return node;
+    }
+
+    i32 concatenation()
+    {
+        i32 node = -1;
+        while (more() && peek() != '|' && peek() != ')')
+        {
+            i32 next = repetition();
+            node = node < 0 ? next : add(RE_CAT, node, next);
+        }
+        return node < 0 ? add(RE_EMPTY) : node;
+    }
+
+    i32 alternation()
+    {
+        i32 node = concatenation();
+        while (more() && peek() == '|')
+        {
+            pos++;
+            node = add(RE_ALT, node, concatenation());
+        }
+        return node;
+    }
+};
+
+// A class nothing can match, such as [^\x00-\xFF], gives no arc at all.
+static void AddArc(RegexGraph& graph, i32 from, i32 to, i32 bytes)
+{
+    if (!ByteSetEmpty(graph.sets[bytes])) graph.arcs.push_back({from, to, bytes});
+}
+
+static RegexGraph Thompson(const Parser& parser, i32 root)
+{
+    struct Fragment { i32 start; i32 end; };
+    RegexGraph graph = {};
+    graph.sets = parser.sets;
+    std::vector<Fragment> frags(parser.nodes.size());
+    auto state = [&]() { return graph.num_states++; };
+    auto eps = [&](i32 from, i32 to) { graph.arcs.push_back({from, to, REGEX_EPSILON}); };
+
+    i32 start = state();
+    for (size_t i = 0; i < parser.nodes.size(); i++)
+    {
+        const RegexNode& node = parser.nodes[i];
+        const Fragment& l = node.left >= 0 ? frags[node.left] : frags[i];
+        const Fragment& r = node.right >= 0 ? frags[node.right] : frags[i];
+        Fragment f = {};
+        switch (node.op)
+        {
+            case RE_EMPTY:
+                f.start = f.end = state();
+                break;
+            case RE_BYTES:
+                f = {state(), state()};
+                AddArc(graph, f.start, f.end, node.bytes);
+                break;
+            case RE_CAT:
+                eps(l.end, r.start);
+                f = {l.start, r.end};
+                break;
+            case RE_ALT:
+                f = {state(), state()};
+                eps(f.start, l.start);
+                eps(f.start, r.start);
+                eps(l.end, f.end);
+                eps(r.end, f.end);
+                break;
+            case RE_STAR: case RE_PLUS: case RE_OPT:
+                f = {state(), state()};
+                eps(f.start, l.start);
+                eps(l.end, f.end);
+                if (node.op != RE_OPT) eps(l.end, l.start);
+                if (node.op != RE_PLUS) eps(f.start, f.end);
+                break;
+        }
+        frags[i] = f;
+    }
+
+    eps(start, frags[root].start);
+    graph.accepting.assign(graph.num_states, false);
+    graph.accepting[frags[root].end] = true;
+    return graph;
+}
+
+// First and last position sets are unions of disjoint sets, so they are kept
+// as trees whose leaves are positions and a union is a single new node.
+struct PositionTrees {
+    struct Tree { i32 left; i32 right; i32 pos; };
+    std::vector<Tree> trees;
+    std::vector<i32> stack;
+
+    i32 leaf(i32 pos) { trees.push_back({-1, -1, pos}); return (i32)trees.size() - 1; }
+    i32 join(i32 a, i32 b)
+    {
+        if (a < 0) return b;
+        if (b < 0) return a;
+        trees.push_back({a, b, -1});
+        return (i32)trees.size() - 1;
+    }
+
+    template <typename F>
+    void each(i32 t, F&& f)
+    {
+        if (t < 0) return;
+        stack.push_back(t);
+        while (!stack.empty())
+        {
+            const Tree tree = trees[stack.back()];
+            stack.pop_back();
+            if (tree.pos >= 0) f(tree.pos);
+            else
+            {
+                stack.push_back(tree.right);
+                stack.push_back(tree.left);
+            }
+        }
+    }
+};
+
+static RegexGraph Glushkov(const Parser& parser, i32 root)
+{
+    struct Info { bool nullable; i32 first; i32 last; };
+    std::vector<Info> info(parser.nodes.size());
+    std::vector<i32> set_of_pos = {-1};
+    PositionTrees trees;
+    std::vector<std::pair<i32, i32>> follow;
+
+    auto link = [&](i32 last, i32 first) {
+        std::vector<i32> targets;
+        trees.each(first, [&](i32 q) { targets.push_back(q); });
+        trees.each(last, [&](i32 p) {
+            for (i32 q: targets) follow.push_back({p, q});
+        });
+    };
+
+    for (size_t i = 0; i < parser.nodes.size(); i++)
+    {
+        const RegexNode& node = parser.nodes[i];
+        Info l = node.left >= 0 ? info[node.left] : Info{};
+        Info r = node.right >= 0 ? info[node.right] : Info{};
+        Info out = {};
+        switch (node.op)
+        {
+            case RE_EMPTY:
+                out = {true, -1, -1};
+                break;
+            case RE_BYTES: {
+                i32 pos = (i32)set_of_pos.size();
+                set_of_pos.push_back(node.bytes);
+                i32 t = trees.leaf(pos);
+                out = {false, t, t};
+            } break;
+            case RE_CAT:
+                link(l.last, r.first);
+                out.nullable = l.nullable && r.nullable;
+                out.first = l.nullable ? trees.join(l.first, r.first) : l.first;
+                out.last = r.nullable ? trees.join(l.last, r.last) : r.last;
+                break;
+            case RE_ALT:
+                out = {l.nullable || r.nullable, trees.join(l.first, r.first), trees.join(l.last, r.last)};
+                break;
+            case RE_STAR: case RE_PLUS: case RE_OPT:
+                if (node.op != RE_OPT) link(l.last, l.first);
+                out = {node.op == RE_PLUS ? l.nullable : true, l.first, l.last};
+                break;
+        }
+        info[i] = out;
+    }
+
+    RegexGraph graph = {};
+    graph.num_states = (i32)set_of_pos.size();
+    graph.sets = parser.sets;
+    trees.each(info[root].first, [&](i32 q) { follow.push_back({0, q}); });
+
+    // Overlapping stars such as (a*b*)* link some pairs twice.
+    std::sort(follow.begin(), follow.end());
+    follow.erase(std::unique(follow.begin(), follow.end()), follow.end());
+    for (const auto& f: follow) AddArc(graph, f.first, f.second, set_of_pos[f.second]);
+
+    graph.accepting.assign(graph.num_states, false);
+    trees.each(info[root].last, [&](i32 p) { graph.accepting[p] = true; });
+    graph.accepting[0] = info[root].nullable;
+    return graph;
+}
+
+RegexGraph CompileRegex(const std::string& pattern, REGEX_CONSTRUCTION construction)
+{
+    Parser parser = {pattern, 0, 0, {}, {}};
+    i32 root = parser.alternation();
+    if (parser.more()) parser.fail("UNMATCHED )");
+    return construction == REGEX_THOMPSON ? Thompson(parser, root) : Glushkov(parser, root);
+}
+
+ByteSet ParseByteSet(const std::string& text)
+{
+    std::string pattern = "[" + text + "]";
+    Parser parser = {pattern, 1, 0, {}, {}};
+    parser.byte_class();
+    if (parser.more()) parser.fail("UNMATCHED ]");
+    if (ByteSetEmpty(parser.sets.back())) parser.fail("EMPTY CLASS");
+    return parser.sets.back();
+}
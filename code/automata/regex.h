@@ -0,0 +1,41 @@
+#pragma once
+#ifndef REGEX
+#define REGEX
+
+#include <string>
+#include <vector>
+#include "../vstd/vtypes.h"
+#include "bitset.h"
+
+constexpr i32 REGEX_EPSILON = -1;
+constexpr i32 REGEX_MAX_DEPTH = 1000;
+
+enum REGEX_CONSTRUCTION { REGEX_GLUSHKOV, REGEX_THOMPSON };
+
+struct RegexArc {
+    i32 from;
+    i32 to;
+    i32 bytes;  // index into RegexGraph::sets, REGEX_EPSILON for an empty move
+};
+
+// Automaton built from a pattern, state 0 is the start.
+struct RegexGraph {
+    i32 num_states;
+    std::vector<bool> accepting;
+    std::vector<RegexArc> arcs;
+    std::vector<ByteSet> sets;  // one per class in the pattern, shared by its arcs
+};
+
+// Supports | * + ? ( ) . [a-z] [^...] and the escapes \n \t \r \xHH; any
+// other escaped byte is literal. Thompson gives about two states per symbol
+// and empty moves, Glushkov one state per symbol plus the start and no
+// empty moves. A symbol is one arc whatever its class, so [a-z] costs the
+// same as a. Both run in time linear in the pattern and the arcs produced.
+// Throws std::runtime_error on a malformed pattern.
+RegexGraph CompileRegex(const std::string& pattern, REGEX_CONSTRUCTION construction);
+
+// The inside of a [...] class, as typed on an arc: a, a-z0-9, ^\n and so on.
+// Throws std::runtime_error on a malformed or empty class.
+ByteSet ParseByteSet(const std::string& text);
+
+#endif
@@ -0,0 +1,104 @@
+#include "shuffle_dfa.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SHUFFLE_DFA_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define SHUFFLE_DFA_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(SHUFFLE_DFA_X86) && !defined(_MSC_VER)
+#define SHUFFLE_DFA_TARGET __attribute__((target("ssse3")))
+#else
+#define SHUFFLE_DFA_TARGET
+#endif
+
+bool ShuffleDfaSupported()
+{
+#if defined(SHUFFLE_DFA_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] >> 9) & 1;
+#elif defined(SHUFFLE_DFA_X86)
+    return __builtin_cpu_supports("ssse3");
+#elif defined(SHUFFLE_DFA_NEON)
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool ShuffleDfaFits(const Automaton& dfa)
+{
+    return dfa.num_states <= SHUFFLE_DFA_LANES;
+}
+
+void CompileShuffleDfa(const Automaton& dfa, ShuffleDfa& out)
+{
+    // Lanes past num_states go to the sink.
+    for (i32 c = 0; c < ALPHABET_SIZE; c++)
+    {
+        for (i32 s = 0; s < SHUFFLE_DFA_LANES; s++)
+        {
+            out.table[c][s] = s < dfa.num_states ? (u8)dfa.next((u32)s, (u8)c) : (u8)DEAD_STATE;
+        }
+    }
+}
+
+void AttachShuffleDfa(Automaton& dfa)
+{
+    dfa.shuffle.reset();
+    if (!ShuffleDfaFits(dfa) || !ShuffleDfaSupported()) return;
+    auto shuffle = std::make_shared<ShuffleDfa>();
+    CompileShuffleDfa(dfa, *shuffle);
+    dfa.shuffle = shuffle;
+}
+
+SHUFFLE_DFA_TARGET
+void ShuffleDfa::run(std::string_view input, u8* map) const
+{
+    const u8* p = (const u8*)input.data();
+    const u8* end = p + input.size();
+
+#if defined(SHUFFLE_DFA_X86)
+    __m128i s = _mm_loadu_si128((const __m128i*)map);
+    while (end - p >= 4)
+    {
+        s = _mm_shuffle_epi8(_mm_load_si128((const __m128i*)table[p[0]]), s);
+        s = _mm_shuffle_epi8(_mm_load_si128((const __m128i*)table[p[1]]), s);
+        s = _mm_shuffle_epi8(_mm_load_si128((const __m128i*)table[p[2]]), s);
+        s = _mm_shuffle_epi8(_mm_load_si128((const __m128i*)table[p[3]]), s);
+        p += 4;
+    }
+    while (p < end)
+    {
+        s = _mm_shuffle_epi8(_mm_load_si128((const __m128i*)table[*p++]), s);
+    }
+    _mm_storeu_si128((__m128i*)map, s);
+#elif defined(SHUFFLE_DFA_NEON)
+    uint8x16_t s = vld1q_u8(map);
+    while (p < end)
+    {
+        s = vqtbl1q_u8(vld1q_u8(table[*p++]), s);
+    }
+    vst1q_u8(map, s);
+#else
+    while (p < end)
+    {
+        const u8* t = table[*p++];
+        for (i32 i = 0; i < SHUFFLE_DFA_LANES; i++) map[i] = t[map[i]];
+    }
+#endif
+}
+
+u32 ShuffleDfa::scan(std::string_view input, u32 state) const
+{
+    alignas(16) u8 map[SHUFFLE_DFA_LANES];
+    for (i32 i = 0; i < SHUFFLE_DFA_LANES; i++) map[i] = (u8)i;
+    run(input, map);
+    return map[state];
+}
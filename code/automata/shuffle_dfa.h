@@ -0,0 +1,29 @@
+#pragma once
+#ifndef SHUFFLE_DFA
+#define SHUFFLE_DFA
+
+#include <string_view>
+#include "../vstd/vtypes.h"
+#include "automaton.h"
+
+constexpr i32 SHUFFLE_DFA_LANES = 16;
+
+// Automata with at most 16 states (sink included) keep one 16 byte vector
+// per input byte, lane s holding the successor of s. The running state map
+// is then advanced with a single PSHUFB/TBL per byte, and the table load
+// only depends on the input, never on the previous state.
+struct ShuffleDfa {
+    alignas(16) u8 table[ALPHABET_SIZE][SHUFFLE_DFA_LANES];
+
+    // map[s] becomes the state reached from map[s] after input.
+    void run(std::string_view input, u8* map) const;
+    u32 scan(std::string_view input, u32 state) const;
+};
+
+bool ShuffleDfaSupported();
+bool ShuffleDfaFits(const Automaton& dfa);
+void CompileShuffleDfa(const Automaton& dfa, ShuffleDfa& out);
+// Gives dfa a shuffle kernel when it fits and the CPU supports it.
+void AttachShuffleDfa(Automaton& dfa);
+
+#endif
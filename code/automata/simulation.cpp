@@ -0,0 +1,43 @@
+#include "simulation.h"
+
+void Simulation::reset(const CanvasCsr& csr, const std::string& new_input)
+{
+    nfa = CompileNfa(csr);
+    input = new_input;
+    state_of_node = csr.state_of_node;
+    rewind();
+}
+
+void Simulation::rewind()
+{
+    pos = 0;
+    active = nfa.initial;
+    previous.assign(nfa.num_words, 0);
+}
+
+void Simulation::step(size_t count)
+{
+    for (size_t i = 0; i < count && !done(); i++)
+    {
+        previous.swap(active);
+        nfa.step(previous.data(), (u8)input[pos++], active.data());
+    }
+}
+
+bool Simulation::node_active(i32 node_id) const
+{
+    if (node_id <= 0 || node_id >= (i32)state_of_node.size()) return false;
+    i32 s = state_of_node[node_id];
+    return s >= 0 && BitsetTest(active.data(), s);
+}
+
+bool Simulation::arc_taken(const arc& a) const
+{
+    // Empty moves are already folded into active, so one is taken whenever
+    // its source is active.
+    if (a.epsilon) return node_active(a.info.node_id) && node_active(a.info.other_id);
+    if (pos == 0 || !BitsetTest(a.bytes.data(), (u8)input[pos - 1])) return false;
+    if (a.info.node_id <= 0 || a.info.node_id >= (i32)state_of_node.size()) return false;
+    i32 from = state_of_node[a.info.node_id];
+    return from >= 0 && BitsetTest(previous.data(), from) && node_active(a.info.other_id);
+}
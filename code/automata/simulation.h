@@ -0,0 +1,32 @@
+#pragma once
+#ifndef SIMULATION
+#define SIMULATION
+
+#include <string>
+#include <vector>
+#include "../graph.h"
+#include "../vstd/vtypes.h"
+#include "nfa.h"
+
+// Resumable run of the canvas Nfa over an input. Every call to step only
+// advances the symbols asked for, so long inputs can be played a few symbols
+// per frame. previous and last_byte describe the step just taken.
+struct Simulation {
+    Nfa nfa;
+    std::string input;
+    size_t pos;
+    std::vector<u64> active;
+    std::vector<u64> previous;
+    std::vector<i32> state_of_node;  // -1 for nodes not in the Nfa
+
+    void reset(const CanvasCsr& csr, const std::string& new_input);
+    void rewind();
+    bool done() const { return pos >= input.size(); }
+    void step(size_t count);
+
+    bool accepting() const { return nfa.is_accepting(active.data()); }
+    bool node_active(i32 node_id) const;
+    bool arc_taken(const arc& a) const;
+};
+
+#endif
@@ -0,0 +1,43 @@
+#include "stream_scan.h"
+#include <stdexcept>
+#include <vector>
+#include "../vstd/vgeneral.h"
+#include "parallel_scan.h"
+
+u32 ScanStream(const Automaton& dfa, FILE* stream, MatchCallback callback, void* user)
+{
+    std::vector<char> buffer(STREAM_SCAN_BUFFER);
+    u32 state = dfa.start;
+    u64 offset = 0;
+    size_t read;
+    while (state != DEAD_STATE && (read = fread(buffer.data(), 1, buffer.size(), stream)) > 0)
+    {
+        state = dfa.find_matches(std::string_view(buffer.data(), read), state, offset, callback, user);
+        offset += read;
+    }
+    return state;
+}
+
+// Closes the file on every way out, a throwing callback included.
+struct StreamGuard {
+    FILE* stream;
+    ~StreamGuard() { if (stream) fclose(stream); }
+};
+
+u32 ScanFile(const Automaton& dfa, const std::string& path, MatchCallback callback, void* user, i32 num_threads)
+{
+    if (path == "-") return ScanStream(dfa, stdin, callback, user);
+
+    MappingGuard mapping = {MapFile(path)};
+    if (mapping.file.data)
+    {
+        return ParallelFindMatches(dfa, std::string_view(mapping.file.data, mapping.file.size), dfa.start, 0, callback, user, num_threads);
+    }
+
+    StreamGuard file = {fopen(path.c_str(), "rb")};
+    if (!file.stream)
+    {
+        throw std::runtime_error("FAILED TO OPEN FILE: " + path);
+    }
+    return ScanStream(dfa, file.stream, callback, user);
+}
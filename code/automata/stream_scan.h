@@ -0,0 +1,19 @@
+#pragma once
+#ifndef STREAM_SCAN
+#define STREAM_SCAN
+
+#include <cstdio>
+#include <string>
+#include "../vstd/vtypes.h"
+#include "automaton.h"
+
+constexpr size_t STREAM_SCAN_BUFFER = 1 << 20;
+
+// Runs dfa from its start state over the file and reports the end offset of
+// every match. Regular files are memory mapped and may be split across
+// num_threads (0 = all hardware threads). Pipes and "-" (stdin) are read in
+// STREAM_SCAN_BUFFER pieces. Returns the state after the last byte.
+u32 ScanFile(const Automaton& dfa, const std::string& path, MatchCallback callback, void* user, i32 num_threads = 1);
+u32 ScanStream(const Automaton& dfa, FILE* stream, MatchCallback callback, void* user);
+
+#endif
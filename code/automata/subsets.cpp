@@ -0,0 +1,88 @@
+#include "subsets.h"
+#include <cstring>
+
+constexpr u32 SUBSET_EMPTY_SLOT = 0xFFFFFFFF;
+constexpr size_t SUBSET_MIN_SLOTS = 64;
+
+static u64 HashSet(const u64* set, i32 words)
+{
+    u64 h = 0x9E3779B97F4A7C15ull;
+    for (i32 i = 0; i < words; i++)
+    {
+        h ^= set[i];
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 32;
+    }
+    return h;
+}
+
+SubsetSpace MakeSubsetSpace(const Nfa& nfa)
+{
+    SubsetSpace space = {};
+    space.nfa = &nfa;
+    space.slots.assign(SUBSET_MIN_SLOTS, SUBSET_EMPTY_SLOT);
+    space.scratch.resize(nfa.num_words);
+    return space;
+}
+
+std::vector<u8> JointClassBytes(const Nfa& a, const Nfa& b)
+{
+    std::vector<u8> bytes;
+    std::vector<bool> seen((size_t)a.num_classes * b.num_classes, false);
+    for (i32 byte = 0; byte < ALPHABET_SIZE; byte++)
+    {
+        size_t key = (size_t)a.byte_class[byte] * b.num_classes + b.byte_class[byte];
+        if (seen[key]) continue;
+        seen[key] = true;
+        bytes.push_back((u8)byte);
+    }
+    return bytes;
+}
+
+u32 SubsetSpace::find_or_add(const u64* set)
+{
+    i32 words = nfa->num_words;
+    size_t mask = slots.size() - 1;
+    size_t slot = HashSet(set, words) & mask;
+    while (slots[slot] != SUBSET_EMPTY_SLOT)
+    {
+        u32 id = slots[slot];
+        if (memcmp(this->set(id), set, sizeof(u64) * words) == 0) return id;
+        slot = (slot + 1) & mask;
+    }
+
+    u32 id = (u32)num_sets++;
+    sets.insert(sets.end(), set, set + words);
+    trans.resize(trans.size() + nfa->num_classes, SUBSET_UNKNOWN);
+    slots[slot] = id;
+
+    // Keep the load under a half, the table is rebuilt from sets.
+    if ((size_t)num_sets * 2 > slots.size())
+    {
+        slots.assign(slots.size() * 2, SUBSET_EMPTY_SLOT);
+        mask = slots.size() - 1;
+        for (u32 s = 0; s < (u32)num_sets; s++)
+        {
+            size_t i = HashSet(this->set(s), words) & mask;
+            while (slots[i] != SUBSET_EMPTY_SLOT) i = (i + 1) & mask;
+            slots[i] = s;
+        }
+    }
+    return id;
+}
+
+u32 SubsetSpace::next(u32 id, u8 byte)
+{
+    u32& cached = trans[(size_t)id * nfa->num_classes + nfa->byte_class[byte]];
+    if (cached != SUBSET_UNKNOWN) return cached;
+    nfa->step(set(id), byte, scratch.data());
+    u32 t = find_or_add(scratch.data());
+    // find_or_add may have grown trans.
+    trans[(size_t)id * nfa->num_classes + nfa->byte_class[byte]] = t;
+    return t;
+}
+
+size_t SubsetSpace::bytes() const
+{
+    return sizeof(u64) * sets.capacity() + sizeof(u32) * (trans.capacity() + slots.capacity());
+}
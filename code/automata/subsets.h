@@ -0,0 +1,37 @@
+#pragma once
+#ifndef SUBSETS
+#define SUBSETS
+
+#include <vector>
+#include "../vstd/vtypes.h"
+#include "nfa.h"
+
+constexpr u32 SUBSET_UNKNOWN = 0xFFFFFFFF;
+
+// Subsets of an Nfa interned on demand, with the successor of every subset
+// cached per byte class. Unlike LazyDfa nothing is flushed, so ids stay valid
+// and callers can key their own tables on them.
+struct SubsetSpace {
+    const Nfa* nfa;
+    i32 num_sets;
+    std::vector<u64> sets;     // [set][num_words]
+    std::vector<u32> trans;    // [set][num_classes]
+    std::vector<u32> slots;    // open addressing over sets
+    std::vector<u64> scratch;
+
+    const u64* set(u32 id) const { return &sets[(size_t)id * nfa->num_words]; }
+    bool accepting(u32 id) const { return nfa->is_accepting(set(id)); }
+    bool empty(u32 id) const { return !BitsetAny(set(id), nfa->num_words); }
+
+    u32 find_or_add(const u64* set);
+    u32 initial() { return find_or_add(nfa->initial.data()); }
+    u32 next(u32 id, u8 byte);
+    size_t bytes() const;
+};
+
+SubsetSpace MakeSubsetSpace(const Nfa& nfa);
+
+// Lowest byte of every pair of classes of a and b that some byte falls in.
+std::vector<u8> JointClassBytes(const Nfa& a, const Nfa& b);
+
+#endif
@@ -0,0 +1,82 @@
+#include "test_suite.h"
+#include "bitset.h"
+#include "nfa.h"
+
+void TestSuite::add(const std::string& label, const std::string& input, bool expect_accept)
+{
+    TestCase test = {};
+    test.label = label;
+    test.input = input;
+    test.expect_accept = expect_accept;
+    test.dirty = true;
+    tests.push_back(test);
+    any_dirty = true;
+}
+
+void TestSuite::remove(size_t idx)
+{
+    tests.erase(tests.begin() + idx);
+}
+
+void TestSuite::invalidate_node(i32 node_id)
+{
+    for (auto& test: tests)
+    {
+        // Nodes added after the run are past the end of its trace.
+        bool visited = node_id < (i32)test.trace.size() * 64 && BitsetTest(test.trace.data(), node_id);
+        if (test.dirty || test.trace.empty() || visited)
+        {
+            test.dirty = true;
+            any_dirty = true;
+        }
+    }
+}
+
+void TestSuite::invalidate_all()
+{
+    for (auto& test: tests) test.dirty = true;
+    any_dirty = !tests.empty();
+}
+
+void TestSuite::rerun(const CanvasCsr& csr)
+{
+    if (!any_dirty) return;
+    any_dirty = false;
+
+    Nfa nfa = CompileNfa(csr);
+    i32 words = nfa.num_words;
+    std::vector<u64> cur(words), next(words), visited(words);
+
+    for (auto& test: tests)
+    {
+        if (!test.dirty) continue;
+        test.dirty = false;
+
+        cur = nfa.initial;
+        visited = cur;
+        for (char c: test.input)
+        {
+            nfa.step(cur.data(), (u8)c, next.data());
+            cur.swap(next);
+            for (i32 w = 0; w < words; w++) visited[w] |= cur[w];
+            if (!BitsetAny(cur.data(), words)) break;
+        }
+        test.accepted = nfa.is_accepting(cur.data());
+
+        test.trace.assign(BitsetWords((i32)csr.state_of_node.size()), 0);
+        for (i32 s = 0; s < nfa.num_states; s++)
+        {
+            if (BitsetTest(visited.data(), s)) BitsetSet(test.trace.data(), nfa.node_ids[s]);
+        }
+    }
+}
+
+i32 TestSuite::passed() const
+{
+    i32 count = 0;
+    for (const auto& test: tests)
+    {
+        if (!test.dirty && test.accepted == test.expect_accept) count++;
+    }
+    return count;
+}
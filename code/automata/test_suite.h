@@ -0,0 +1,39 @@
+#pragma once
+#ifndef TEST_SUITE
+#define TEST_SUITE
+
+#include <string>
+#include <vector>
+#include "../graph.h"
+#include "csr.h"
+#include "../vstd/vtypes.h"
+
+struct TestCase {
+    std::string label;
+    std::string input;
+    bool expect_accept;
+    bool accepted;
+    bool dirty;
+    std::vector<u64> trace;  // canvas node ids that were active at any step
+};
+
+// Labelled strings kept with the automaton. Every run records which nodes it
+// went through; an edit to a node can only change the outcome of tests that
+// visited it, so only those are run again.
+struct TestSuite {
+    std::vector<TestCase> tests;
+    bool any_dirty;
+
+    void add(const std::string& label, const std::string& input, bool expect_accept);
+    void remove(size_t idx);
+
+    // Arcs leaving node_id changed, or node_id changed kind or was deleted.
+    void invalidate_node(i32 node_id);
+    // The set of INIT nodes changed, every run starts differently.
+    void invalidate_all();
+
+    void rerun(const CanvasCsr& csr);
+    i32 passed() const;
+};
+
+#endif
@@ -0,0 +1,265 @@
+#include "to_regex.h"
+#include <algorithm>
+#include <cstdio>
+#include <queue>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include "automaton.h"
+#include "bitset.h"
+
+enum LABEL_KIND { LABEL_EMPTY, LABEL_BYTES, LABEL_EXPR };
+
+// Binding of the top operator, so parentheses are only added when needed.
+enum LABEL_PREC { PREC_ALT, PREC_CAT, PREC_ATOM };
+
+struct Label {
+    LABEL_KIND kind;
+    ByteSet bytes;             // LABEL_BYTES
+    std::string text;          // LABEL_EXPR
+    LABEL_PREC prec;
+    bool optional;             // text already ends in ? or *
+
+    size_t length() const { return kind == LABEL_EXPR ? text.size() : kind == LABEL_BYTES ? 4 : 0; }
+};
+
+static bool IsMeta(u8 c)
+{
+    return c == '|' || c == '*' || c == '+' || c == '?' || c == '(' || c == ')' || c == '[' || c == ']' || c == '.' || c == '\\';
+}
+
+static void AppendByte(std::string& out, u8 c, bool in_class)
+{
+    char buff[8];
+    if (c < ' ' || c >= 127) snprintf(buff, sizeof(buff), "\\x%02X", c);
+    else if (in_class ? (c == ']' || c == '\\' || c == '^' || c == '-') : IsMeta(c)) snprintf(buff, sizeof(buff), "\\%c", c);
+    else snprintf(buff, sizeof(buff), "%c", c);
+    out += buff;
+}
+
+std::string ByteSetText(const ByteSet& bytes)
+{
+    i32 count = 0;
+    for (u64 w: bytes) count += PopCount(w);
+    std::string out;
+    if (count == 1)
+    {
+        for (i32 b = 0; b < ALPHABET_SIZE; b++) if (BitsetTest(bytes.data(), b)) AppendByte(out, (u8)b, false);
+        return out;
+    }
+    // The complement would be empty and [^] does not parse.
+    if (count == ALPHABET_SIZE) return "[\\x00-\\xFF]";
+
+    ByteSet set = bytes;
+    bool negate = count > ALPHABET_SIZE / 2;
+    if (negate)
+    {
+        if (count == ALPHABET_SIZE - 1 && !BitsetTest(bytes.data(), '\n')) return ".";
+        for (auto& w: set) w = ~w;
+    }
+    out = negate ? "[^" : "[";
+    for (i32 b = 0; b < ALPHABET_SIZE;)
+    {
+        if (!BitsetTest(set.data(), b)) { b++; continue; }
+        i32 end = b;
+        while (end + 1 < ALPHABET_SIZE && BitsetTest(set.data(), end + 1)) end++;
+        AppendByte(out, (u8)b, true);
+        if (end > b + 1) out += "-";
+        if (end > b) AppendByte(out, (u8)end, true);
+        b = end + 1;
+    }
+    return out + "]";
+}
+
+static Label EmptyLabel()
+{
+    return {LABEL_EMPTY, {}, "", PREC_ATOM, false};
+}
+
+static Label Expr(const Label& l)
+{
+    if (l.kind != LABEL_BYTES) return l;
+    Label out = {LABEL_EXPR, {}, ByteSetText(l.bytes), PREC_ATOM, false};
+    return out;
+}
+
+static std::string Wrap(const Label& l, LABEL_PREC need)
+{
+    return l.prec < need ? "(" + l.text + ")" : l.text;
+}
+
+static Label Union(const Label& a, const Label& b)
+{
+    if (a.kind == LABEL_BYTES && b.kind == LABEL_BYTES)
+    {
+        Label out = a;
+        for (i32 w = 0; w < 4; w++) out.bytes[w] |= b.bytes[w];
+        return out;
+    }
+    // x|empty is x?
+    if (a.kind == LABEL_EMPTY || b.kind == LABEL_EMPTY)
+    {
+        Label x = Expr(a.kind == LABEL_EMPTY ? b : a);
+        if (x.kind == LABEL_EMPTY || x.optional) return x;
+        return {LABEL_EXPR, {}, Wrap(x, PREC_ATOM) + "?", PREC_ATOM, true};
+    }
+    Label x = Expr(a), y = Expr(b);
+    if (x.text == y.text) return x;
+    return {LABEL_EXPR, {}, x.text + "|" + y.text, PREC_ALT, false};
+}
+
+static Label Concat(const Label& a, const Label& b)
+{
+    if (a.kind == LABEL_EMPTY) return b;
+    if (b.kind == LABEL_EMPTY) return a;
+    Label x = Expr(a), y = Expr(b);
+    return {LABEL_EXPR, {}, Wrap(x, PREC_CAT) + Wrap(y, PREC_CAT), PREC_CAT, false};
+}
+
+static Label Star(const Label& a)
+{
+    if (a.kind == LABEL_EMPTY) return a;
+    Label x = Expr(a);
+    std::string text = x.text;
+    // (y?)* and (y*)* are y*.
+    if (x.optional) text.pop_back();
+    else text = Wrap(x, PREC_ATOM);
+    return {LABEL_EXPR, {}, text + "*", PREC_ATOM, true};
+}
+
+std::string CanvasToRegex(const CanvasCsr& csr, size_t max_length)
+{
+    // Canvas state s is s + 1 here, 0 is a new start with empty moves to
+    // every INIT node and num_states + 1 a new end reached by empty moves
+    // from every GOAL node.
+    const i32 begin_id = 0;
+    const i32 end_id = csr.num_states + 1;
+    const i32 count = end_id + 1;
+    std::vector<std::unordered_map<i32, Label>> out(count);
+    std::vector<std::vector<i32>> in(count);
+
+    auto add = [&](i32 from, i32 to, const Label& label) {
+        auto it = out[from].find(to);
+        if (it == out[from].end())
+        {
+            out[from].emplace(to, label);
+            in[to].push_back(from);
+        }
+        else
+        {
+            it->second = Union(it->second, label);
+        }
+    };
+
+    for (i32 s = 0; s < csr.num_states; s++)
+    {
+        if (IsInitial(csr.kind[s])) add(begin_id, s + 1, EmptyLabel());
+        if (IsAccepting(csr.kind[s])) add(s + 1, end_id, EmptyLabel());
+        for (const CsrArc* a = csr.begin(s); a != csr.end(s); a++)
+        {
+            Label label = EmptyLabel();
+            if (a->label != CSR_EPSILON)
+            {
+                label.kind = LABEL_BYTES;
+                label.bytes = csr.class_bytes[a->label];
+            }
+            add(s + 1, a->to + 1, label);
+        }
+    }
+
+    // Only states on some path from the start to the end matter.
+    std::vector<bool> forward(count, false), backward(count, false);
+    std::vector<i32> stack = {begin_id};
+    forward[begin_id] = true;
+    while (!stack.empty())
+    {
+        i32 s = stack.back();
+        stack.pop_back();
+        for (const auto& e: out[s]) if (!forward[e.first]) { forward[e.first] = true; stack.push_back(e.first); }
+    }
+    stack = {end_id};
+    backward[end_id] = true;
+    while (!stack.empty())
+    {
+        i32 s = stack.back();
+        stack.pop_back();
+        for (i32 p: in[s]) if (!backward[p]) { backward[p] = true; stack.push_back(p); }
+    }
+    if (!forward[end_id]) return "[^\\x00-\\xFF]";
+
+    std::vector<bool> alive(count, false);
+    for (i32 s = 0; s < count; s++) alive[s] = forward[s] && backward[s];
+    for (i32 s = 0; s < count; s++)
+    {
+        if (!alive[s]) { out[s].clear(); in[s].clear(); continue; }
+        for (auto it = out[s].begin(); it != out[s].end();)
+        {
+            if (alive[it->first]) ++it;
+            else it = out[s].erase(it);
+        }
+        in[s].erase(std::remove_if(in[s].begin(), in[s].end(), [&](i32 p) { return !alive[p]; }), in[s].end());
+    }
+
+    // Candidates are keyed by (in x out pairs, label weight, id). A key only
+    // changes when a neighbour is eliminated, so the neighbours are pushed
+    // again with a new version and the stale entries are skipped.
+    struct Candidate { u64 pairs; u64 weight; i32 s; u32 version; };
+    auto later = [](const Candidate& a, const Candidate& b) {
+        return std::tie(a.pairs, a.weight, a.s) > std::tie(b.pairs, b.weight, b.s);
+    };
+    std::priority_queue<Candidate, std::vector<Candidate>, decltype(later)> heap(later);
+    std::vector<u32> version(count, 0);
+    auto push = [&](i32 s) {
+        u64 ins = 0, outs = 0, weight = 0;
+        for (i32 p: in[s]) if (p != s) { ins++; weight += out[p][s].length(); }
+        for (const auto& e: out[s]) if (e.first != s) { outs++; weight += e.second.length(); }
+        heap.push({ins * outs, weight, s, ++version[s]});
+    };
+    for (i32 s = 1; s < end_id; s++) if (alive[s]) push(s);
+
+    std::vector<i32> touched;
+    while (!heap.empty())
+    {
+        Candidate top = heap.top();
+        heap.pop();
+        if (!alive[top.s] || top.version != version[top.s]) continue;
+        i32 best = top.s;
+
+        touched = in[best];
+        for (const auto& e: out[best]) touched.push_back(e.first);
+
+        auto self = out[best].find(best);
+        Label loop = self == out[best].end() ? EmptyLabel() : Star(self->second);
+        for (i32 p: in[best])
+        {
+            if (p == best) continue;
+            Label head = Concat(out[p][best], loop);
+            for (const auto& e: out[best])
+            {
+                if (e.first == best) continue;
+                add(p, e.first, Concat(head, e.second));
+                if (out[p][e.first].length() > max_length)
+                {
+                    throw std::runtime_error("REGEX EXPORT ABORTED: LONGER THAN " + std::to_string(max_length) + " CHARACTERS");
+                }
+            }
+            out[p].erase(best);
+        }
+        for (const auto& e: out[best])
+        {
+            auto& preds = in[e.first];
+            preds.erase(std::remove(preds.begin(), preds.end(), best), preds.end());
+        }
+        out[best].clear();
+        in[best].clear();
+        alive[best] = false;
+
+        for (i32 s: touched)
+        {
+            if (s != begin_id && s != end_id && alive[s]) push(s);
+        }
+    }
+
+    return Expr(out[begin_id][end_id]).text;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#ifndef TO_REGEX
+#define TO_REGEX
+
+#include <array>
+#include <string>
+#include "../graph.h"
+#include "csr.h"
+#include "../vstd/vtypes.h"
+
+constexpr size_t TO_REGEX_MAX_LENGTH = 1 << 20;
+
+// State elimination over the canvas, in the syntax CompileRegex reads.
+// States that are not on a path from INIT to GOAL are dropped first, then
+// the state with the fewest in x out arc pairs is eliminated next, ties
+// going to the one whose labels are shortest. Parallel byte arcs are
+// merged into a class. Throws std::runtime_error once the regex grows past
+// max_length.
+std::string CanvasToRegex(const CanvasCsr& csr, size_t max_length = TO_REGEX_MAX_LENGTH);
+
+// A single byte on its own, anything else as a [...] class or '.'.
+std::string ByteSetText(const ByteSet& bytes);
+
+#endif
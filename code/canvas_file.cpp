@@ -0,0 +1,178 @@
+#include "canvas_file.h"
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+
+// Ids index the node arrays directly, so a corrupt file must not be able
+// to ask for an arbitrarily large store.
+constexpr i32 CANVAS_MAX_ID = 1 << 24;
+
+std::string EscapeBytes(const std::string& str)
+{
+    std::string out;
+    char buff[8];
+    for (char c: str)
+    {
+        u8 byte = (u8)c;
+        if (byte > ' ' && byte < 127 && byte != '\\')
+        {
+            out += c;
+            continue;
+        }
+        snprintf(buff, sizeof(buff), "\\x%02X", byte);
+        out += buff;
+    }
+    // Empty strings still need a token.
+    return out.empty() ? "\\e" : out;
+}
+
+static i32 HexDigit(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// False on a backslash that is not a full \xHH escape; EscapeBytes never
+// writes one. out must not be token.
+static bool Unescape(const std::string& token, std::string& out)
+{
+    out.clear();
+    if (token == "\\e") return true;
+    for (size_t i = 0; i < token.size(); i++)
+    {
+        if (token[i] != '\\')
+        {
+            out += token[i];
+            continue;
+        }
+        if (i + 3 >= token.size() || token[i + 1] != 'x') return false;
+        i32 hi = HexDigit(token[i + 2]), lo = HexDigit(token[i + 3]);
+        if (hi < 0 || lo < 0) return false;
+        out += (char)(hi * 16 + lo);
+        i += 3;
+    }
+    return true;
+}
+
+// Runs of bytes as lo-hi, a lone byte as itself.
+static std::string ByteRanges(const ByteSet& bytes)
+{
+    std::string out;
+    char buff[16];
+    for (i32 b = 0; b < ALPHABET_SIZE;)
+    {
+        if (!BitsetTest(bytes.data(), b)) { b++; continue; }
+        i32 end = b;
+        while (end + 1 < ALPHABET_SIZE && BitsetTest(bytes.data(), end + 1)) end++;
+        if (end > b) snprintf(buff, sizeof(buff), " %d-%d", b, end);
+        else snprintf(buff, sizeof(buff), " %d", b);
+        out += buff;
+        b = end + 1;
+    }
+    return out;
+}
+
+std::string SerializeCanvas(const NodeStore& nodes, const TestSuite& tests)
+{
+    std::string out = "PAINTOMATA 1\n";
+    char buff[128];
+    for (i32 id: nodes.live)
+    {
+        snprintf(buff, sizeof(buff), "node %d %d %.2f %.2f %.2f\n", id, nodes.kind[id], nodes.position[id].x, nodes.position[id].y, nodes.radius[id]);
+        out += buff;
+    }
+    for (i32 id: nodes.live)
+    {
+        for (const auto& arc: nodes.arcs[id])
+        {
+            if (!IsLiveArc(nodes, arc)) continue;
+            snprintf(buff, sizeof(buff), "arc %d %d %d", id, arc.info.node_id, arc.info.other_id);
+            out += buff;
+            out += arc.epsilon ? " -1\n" : ByteRanges(arc.bytes) + "\n";
+        }
+    }
+    for (const auto& test: tests.tests)
+    {
+        out += std::string("test ") + (test.expect_accept ? "1 " : "0 ") + EscapeBytes(test.label) + " " + EscapeBytes(test.input) + "\n";
+    }
+    return out;
+}
+
+void ParseCanvas(const std::string& text, NodeStore& nodes, TestSuite* tests)
+{
+    NodeStore parsed = {};
+    TestSuite parsed_tests = {};
+
+    std::istringstream lines(text);
+    std::string line;
+    i32 line_number = 0;
+    auto fail = [&]() {
+        throw std::runtime_error("INVALID AUTOMATON FILE: LINE " + std::to_string(line_number));
+    };
+
+    while (std::getline(lines, line))
+    {
+        line_number++;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+
+        std::istringstream in(line);
+        std::string record;
+        in >> record;
+        if (line_number == 1)
+        {
+            i32 version = 0;
+            if (record != "PAINTOMATA" || !(in >> version) || version != 1) fail();
+        }
+        else if (record == "node")
+        {
+            i32 id, kind;
+            f32 x, y, radius;
+            if (!(in >> id >> kind >> x >> y >> radius)) fail();
+            if (id <= 0 || id >= CANVAS_MAX_ID || kind <= NIL || kind > INIT_GOAL) fail();
+            parsed.place(id, (NODE_KIND)kind, {x, y}, radius);
+        }
+        else if (record == "arc")
+        {
+            i32 owner, from, to;
+            if (!(in >> owner >> from >> to) || !parsed.alive(owner)) fail();
+            if (owner != from && owner != to) fail();
+            arc a = {{from, to}, {}, false};
+            std::string token;
+            while (in >> token)
+            {
+                i32 lo, hi;
+                char extra;
+                if (sscanf(token.c_str(), "%d-%d%c", &lo, &hi, &extra) != 2)
+                {
+                    if (sscanf(token.c_str(), "%d%c", &lo, &extra) != 1) fail();
+                    hi = lo;
+                }
+                if (lo == -1 && hi == -1) a.epsilon = true;
+                else if (lo < 0 || hi < lo || hi > 255) fail();
+                else ByteSetAddRange(a.bytes, lo, hi);
+            }
+            // Either an empty move or some bytes, never both.
+            if (a.epsilon == !ByteSetEmpty(a.bytes) || !IsLiveArc(parsed, a)) fail();
+            parsed.push_arc(owner, a);
+        }
+        else if (record == "test")
+        {
+            i32 expect;
+            std::string label, input, label_bytes, input_bytes;
+            if (!(in >> expect >> label >> input)) fail();
+            if (!Unescape(label, label_bytes) || !Unescape(input, input_bytes)) fail();
+            parsed_tests.add(label_bytes, input_bytes, expect != 0);
+        }
+        else
+        {
+            fail();
+        }
+    }
+    if (line_number == 0) fail();
+
+    nodes.replace(std::move(parsed));
+    if (tests) *tests = std::move(parsed_tests);
+}
@@ -0,0 +1,24 @@
+#pragma once
+#ifndef CANVAS_FILE
+#define CANVAS_FILE
+
+#include <string>
+#include "graph.h"
+#include "automata/test_suite.h"
+
+// Text format, one record per line:
+//   PAINTOMATA 1
+//   node <id> <kind> <x> <y> <radius>
+//   arc <owner> <from> <to> <bytes or lo-hi ranges, -1 for an empty move>
+//   test <expect 0|1> <label> <input>
+// The owner of an arc is one of its endpoints. Labels and inputs escape
+// spaces, backslashes and non printable bytes as \xHH.
+std::string SerializeCanvas(const NodeStore& nodes, const TestSuite& tests);
+
+// Spaces, backslashes and non printable bytes as \xHH, the empty string as \e.
+std::string EscapeBytes(const std::string& str);
+
+// Throws std::runtime_error on malformed input. tests may be null.
+void ParseCanvas(const std::string& text, NodeStore& nodes, TestSuite* tests);
+
+#endif
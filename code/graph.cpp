@@ -0,0 +1,126 @@
+#include "graph.h"
+#include <algorithm>
+
+void NodeStore::clear()
+{
+    kind.clear();
+    position.clear();
+    radius.clear();
+    arcs.clear();
+    holders.clear();
+    live.clear();
+    live_index.clear();
+    free_slots.clear();
+    for (u32& g: generation) g++;
+}
+
+void NodeStore::replace(NodeStore&& other)
+{
+    std::vector<u32> old = std::move(generation);
+    *this = std::move(other);
+    if (generation.size() < old.size()) generation.resize(old.size(), 0);
+    for (size_t id = 0; id < old.size(); id++) generation[id] = std::max(generation[id], old[id] + 1);
+}
+
+void NodeStore::place(i32 id, NODE_KIND node_kind, vec2 node_position, f32 node_radius)
+{
+    if (id >= slots())
+    {
+        for (i32 gap = std::max(slots(), 1); gap < id; gap++) free_slots.push_back(gap);
+        if ((i32)generation.size() < id + 1) generation.resize(id + 1, 0);
+        kind.resize(id + 1, NIL);
+        position.resize(id + 1, {0, 0});
+        radius.resize(id + 1, 0);
+        arcs.resize(id + 1);
+        holders.resize(id + 1);
+        live_index.resize(id + 1, -1);
+    }
+    if (live_index[id] < 0)
+    {
+        live_index[id] = (i32)live.size();
+        live.push_back(id);
+    }
+    else
+    {
+        drop_arcs(id);
+    }
+    kind[id] = node_kind;
+    position[id] = node_position;
+    radius[id] = node_radius;
+}
+
+i32 NodeStore::add(NODE_KIND node_kind, vec2 node_position, f32 node_radius)
+{
+    i32 id = 0;
+    while (!free_slots.empty() && id == 0)
+    {
+        id = free_slots.back();
+        free_slots.pop_back();
+        if (alive(id)) id = 0;
+    }
+    if (id == 0) id = std::max(slots(), 1);
+    place(id, node_kind, node_position, node_radius);
+    return id;
+}
+
+void NodeStore::remove(i32 id)
+{
+    if (!alive(id)) return;
+    drop_arcs(id);
+    i32 last = live.back();
+    live[live_index[id]] = last;
+    live_index[last] = live_index[id];
+    live.pop_back();
+    live_index[id] = -1;
+    kind[id] = NIL;
+    generation[id]++;
+    free_slots.push_back(id);
+}
+
+void NodeStore::add_arc(i32 from, i32 to, const ByteSet& bytes, bool epsilon)
+{
+    i32 owner = from;
+    for (const auto& a: arcs[to])
+    {
+        if (a.info.other_id == from || a.info.node_id == from)
+        {
+            owner = to;
+            break;
+        }
+    }
+    push_arc(owner, {{from, to}, bytes, epsilon});
+}
+
+void NodeStore::push_arc(i32 owner, const arc& a)
+{
+    arcs[owner].push_back(a);
+    for (i32 end: {a.info.node_id, a.info.other_id})
+    {
+        if (end == owner) continue;
+        auto& list = holders[end];
+        if (std::find(list.begin(), list.end(), owner) == list.end()) list.push_back(owner);
+    }
+}
+
+// Arcs owned by id go with its vector; arcs it holds on neighbours are
+// compacted out of theirs.
+void NodeStore::drop_arcs(i32 id)
+{
+    auto touches = [id](const arc& a) { return a.info.node_id == id || a.info.other_id == id; };
+    for (i32 owner: holders[id])
+    {
+        auto& list = arcs[owner];
+        list.erase(std::remove_if(list.begin(), list.end(), touches), list.end());
+    }
+    for (const auto& a: arcs[id])
+    {
+        for (i32 end: {a.info.node_id, a.info.other_id})
+        {
+            if (end == id) continue;
+            auto& list = holders[end];
+            list.erase(std::remove(list.begin(), list.end(), id), list.end());
+        }
+    }
+    arcs[id].clear();
+    holders[id].clear();
+}
@@ -0,0 +1,98 @@
+#pragma once
+#ifndef GRAPH
+#define GRAPH
+
+#include <vector>
+#include "vstd/vtypes.h"
+#include "automata/bitset.h"
+
+enum NODE_KIND: i32 {
+    NIL = 0,
+    NORMAL,
+    INIT,
+    GOAL,
+    INIT_GOAL,
+};
+
+inline bool IsInitial(NODE_KIND kind) { return kind == INIT || kind == INIT_GOAL; }
+inline bool IsAccepting(NODE_KIND kind) { return kind == GOAL || kind == INIT_GOAL; }
+
+struct arc_info {
+    i32 node_id;
+    i32 other_id;
+};
+
+
+struct arc {
+    arc_info info;
+    ByteSet bytes;  // read by the arc, one label covers a whole range
+    bool epsilon;   // taken without reading a byte, bytes is unused
+};
+
+
+// An id plus the generation of its slot when the handle was taken. Slots
+// are reused, so a handle kept across a delete resolves to nothing instead
+// of to whatever node took the slot afterwards.
+struct NodeHandle {
+    i32 id;
+    u32 generation;
+};
+
+// Nodes are stored field by field, so a loop that only needs positions or
+// kinds walks one contiguous array. Slot 0 is never used and free slots have
+// kind NIL; live holds the ids in use, in no particular order, so nothing
+// has to scan the free ones, and free_slots hands them out again in O(1).
+//
+// An arc is kept in the arcs of one of its endpoints, the owner. holders is
+// the reverse index: for every node, the other nodes that own an arc
+// touching it, so removing a node only visits its neighbours.
+struct NodeStore {
+    std::vector<NODE_KIND> kind;
+    std::vector<vec2> position;
+    std::vector<f32> radius;
+    std::vector<std::vector<arc>> arcs;
+    std::vector<std::vector<i32>> holders;
+    std::vector<i32> live;
+    std::vector<i32> live_index;  // position in live, -1 for free slots
+    std::vector<u32> generation;  // bumped every time the slot is freed
+    std::vector<i32> free_slots;  // may hold slots placed since, add skips them
+
+    i32 slots() const { return (i32)kind.size(); }
+    i32 count() const { return (i32)live.size(); }
+    bool alive(i32 id) const { return id > 0 && id < slots() && kind[id] != NIL; }
+
+    NodeHandle handle(i32 id) const { return {id, alive(id) ? generation[id] : 0}; }
+    // 0 when the node was deleted or the canvas replaced since.
+    i32 resolve(NodeHandle h) const { return alive(h.id) && generation[h.id] == h.generation ? h.id : 0; }
+
+    // Generations survive so handles into the old canvas stay stale.
+    void clear();
+    // Takes over other's nodes. Generations only move forward, so handles
+    // into the canvas being replaced stay stale.
+    void replace(NodeStore&& other);
+
+    // Fills slot id, growing the store if needed. Used when ids come from
+    // outside (files, compiled automata).
+    void place(i32 id, NODE_KIND node_kind, vec2 node_position, f32 node_radius);
+    i32 add(NODE_KIND node_kind, vec2 node_position, f32 node_radius);
+    // Drops the node together with every arc touching it.
+    void remove(i32 id);
+
+    // Arcs between the same two nodes share one owner so they can be drawn
+    // as a pair.
+    void add_arc(i32 from, i32 to, const ByteSet& bytes, bool epsilon = false);
+    // For arcs whose owner is already known, as read from a file.
+    void push_arc(i32 owner, const arc& a);
+
+private:
+    void drop_arcs(i32 id);
+};
+
+// Both endpoints have to exist; loaders check arcs with this before they
+// are stored.
+inline bool IsLiveArc(const NodeStore& nodes, const arc& a)
+{
+    return nodes.alive(a.info.node_id) && nodes.alive(a.info.other_id);
+}
+
+#endif
@@ -2,22 +2,42 @@
 #include <array>
 #include "raylib.h"
 #include "vstd/vtypes.h"
+#include "graph.h"
 #include <cstdio>
+#include <cstring>
 #include <vector>
 #include <iostream>
-
-enum NODE_KIND: i32 {
-    NIL = 0,
-    NORMAL,
-    INIT,
-    GOAL,
-};
+#include <stdexcept>
+#include <chrono>
+#include <algorithm>
+#include "imgui.h"
+#include "rlImGui.h"
+#include "vstd/vgeneral.h"
+#include "vstd/vlogger.h"
+#include "automata/automaton.h"
+#include "automata/codegen.h"
+#include "automata/determinize.h"
+#include "automata/minimize.h"
+#include "automata/equivalence.h"
+#include "automata/inclusion.h"
+#include "automata/product.h"
+#include "automata/regex.h"
+#include "automata/to_regex.h"
+#include "automata/enumerate.h"
+#include "automata/reachability.h"
+#include "automata/simulation.h"
+#include "automata/test_suite.h"
+#include "automata/parallel_scan.h"
+#include "automata/lazy_dfa.h"
+#include "automata/batch.h"
+#include "automata/stream_scan.h"
+#include "canvas_file.h"
 
 NODE_KIND next_node_kind (NODE_KIND kind)
 {
     i32 new_val = kind;
     new_val += 1;
-    if(new_val > GOAL)
+    if(new_val > INIT_GOAL)
     {
         new_val = NORMAL;
     }
@@ -30,49 +50,19 @@ constexpr auto NODE_COLOR_A = WHITE;
 constexpr auto NODE_COLOR_B = BLACK;
 constexpr auto ARC_COLOR = BLACK;
 constexpr auto TEXT_COLOR = BLACK;
-
-struct arc_info {
-    i32 node_id;
-    i32 other_id;
-};
-
-
-struct arc {
-    arc_info info;
-    char val;
-};
-
-
-struct Node {
-    NODE_KIND kind;
-    vec2 position;
-    f32 radius;
-    std::vector<arc> arcs;
-    operator bool() const { return kind != NIL; }
-
-    void add_arc (i32 node_id, i32 other_id) {
-        arc temp_arc = {{0}, 0};
-        temp_arc.info = {node_id, other_id};
-        temp_arc.val = 'A';
-        arcs.push_back(temp_arc);
-        for (const auto& arc: arcs)
-        {
-            printf("Arc: id %d other %d\n", arc.info.node_id, arc.info.other_id);
-        }
-        printf("\n");
-    }
-};
-
+constexpr auto NODE_ACTIVE_COLOR = SKYBLUE;
+constexpr auto NODE_USELESS_COLOR = LIGHTGRAY;
+constexpr auto ARC_TAKEN_COLOR = BLUE;
 
 struct Mouse
 {
     bool pressed;
     vec2 pressed_pos;
     vec2 actual_pos;
-    i32 selected_node_idx;
-    // [0] = node
-    // [1] = arch
-    arc_info selected_arc_info;
+    NodeHandle selected_node;
+    // Node whose arcs hold the selected arc, and its index there.
+    NodeHandle selected_arc_owner;
+    i32 selected_arc;
 };
 
 enum e_AppState {
@@ -80,68 +70,96 @@ enum e_AppState {
     CREATE,
     RELATION,
     WRITE,
+    SIMULATE,
 };
 
-constexpr auto MAX_NUM_NODES = 50;
 constexpr auto ARC_SELF_RELATION_OFFSET = 50;
 constexpr auto NODE_GOAL_RADIUS = 40;
 constexpr auto ARROW_INIT_OFFSET = 40;
+constexpr auto NODE_MIN_SIZE = 50;
 
 
 struct App {
     i32 width, height;
-    std::array<Node, MAX_NUM_NODES> nodes;
+    NodeStore nodes;
     Mouse mouse;
     
     e_AppState state;
+    std::string arc_text;  // typed so far for the arc being labelled
+
+    char export_path[256];
+    bool export_constexpr;
+    std::string message;
+
+    Simulation sim;
+    std::string sim_input;
+    bool sim_playing;
+    f32 sim_rate;     // symbols per second
+    f32 sim_budget;   // fraction of a symbol carried to the next frame
+
+    char file_path[256];
+    char other_path[256];
+    bool product_to_canvas;
+    char regex[256];
+    bool regex_thompson;
+
+    WordEnumerator words;
+    std::vector<std::string> word_list;
+    bool words_accepted;
+    i32 words_limit;
+    TestSuite tests;
+    Reachability reach;
+    CsrCache csr;
+    char test_label[64];
+    std::string test_input;
+    bool test_expect;
+    char scan_path[256];
+    i32 scan_threads;  // 0 = all hardware threads
+    bool scan_lazy;    // build DFA states while scanning instead of up front
+
+
+    // The canvas as the engines see it, brought up to date with the edits
+    // made since the last call.
+    const CanvasCsr& graph()
+    {
+        return csr.get(nodes);
+    }
 
-    void delete_arcs_to_id(i32 id)
+    // 0 when nothing is selected.
+    i32 get_node_selected()
     {
-        for(auto& node: nodes)
-        {
-            for (auto& arc: node.arcs)
-            {
-                if (arc.info.other_id == id) 
-                {
-                    arc = {{0}, 0};
-                }
-            }
-        }
+        return nodes.resolve(mouse.selected_node);
     }
 
-    Node* get_node_selected()
+    // Null when the owner was deleted since the arc was picked.
+    arc* get_arc_selected()
     {
-        Node* pnode = &nodes[0];
-        if (mouse.selected_node_idx >= 1) 
-        {
-            pnode = &nodes[mouse.selected_node_idx];
-        }
-        return pnode;
+        i32 owner = nodes.resolve(mouse.selected_arc_owner);
+        if (!owner || mouse.selected_arc >= (i32)nodes.arcs[owner].size()) return nullptr;
+        return &nodes.arcs[owner][mouse.selected_arc];
     }
 
     arc_info check_arc_collision(vec2 pos)
     {
-        for (int i = 1; i < nodes.size(); i++)
+        for (i32 i: nodes.live)
         {
-            const auto& node = nodes[i];
-            if (!node) continue;
-            vec2 startpos = node.position;
-            for (int j = 0; j < node.arcs.size(); j++)
+            const auto& arcs = nodes.arcs[i];
+            vec2 startpos = nodes.position[i];
+            for (int j = 0; j < arcs.size(); j++)
             {
                 // Bezier
-                if (node.arcs[j].info.other_id == node.arcs[j].info.node_id)
+                if (arcs[j].info.other_id == arcs[j].info.node_id)
                 {
-                    Vector2 circle_collider_pos = {node.position.x, node.position.y};
-                    circle_collider_pos.y -= node.radius; 
+                    Vector2 circle_collider_pos = {startpos.x, startpos.y};
+                    circle_collider_pos.y -= nodes.radius[i]; 
                     circle_collider_pos.y -= ARC_SELF_RELATION_OFFSET * 0.5f;
                     if(CheckCollisionPointCircle({pos.x, pos.y},  circle_collider_pos, ARC_SELF_RELATION_OFFSET * 0.6f))
                         return { i, j };
                 }
                 else 
                 {
-                    const auto& endnode = nodes[node.arcs[j].info.other_id];
-                    if (!endnode) continue;
-                    vec2 endpos = endnode.position;
+                    if (!nodes.alive(arcs[j].info.other_id)) continue;
+                    vec2 endpos = nodes.position[arcs[j].info.other_id];
                     if (CheckCollisionPointLine({pos.x, pos.y}, { startpos.x, startpos.y }, { endpos.x, endpos.y }, 10))
                         return { i, j };
                 }
@@ -157,10 +175,9 @@ struct App {
     i32 check_collision(vec2 pos)
     {
         int id = 0;
-        for (int i = 0; i < nodes.size(); i++)
+        for (i32 i: nodes.live)
         {
-            Node& node = nodes[i];
-            if (Vec2Length(node.position - pos) < node.radius)
+            if (Vec2Length(nodes.position[i] - pos) < nodes.radius[i])
             {
                 id = i;
                 break;
@@ -169,42 +186,144 @@ struct App {
         return id;
     }
 
-    i32 get_empty()
+    // Replaces the canvas with dfa, states on a circle around the middle of
+    // the window. The sink is left out.
+    void load_automaton(const Automaton& dfa)
     {
-        i32 id = -1;
-        for (int i = 1; i < nodes.size(); i++)
+        nodes.clear();
+        mouse.selected_node = {};
+        i32 count = dfa.num_states - 1;
+        f32 ring = fmax(width * 0.35f, count * NODE_MIN_SIZE * 1.5f / (2.0f * PI));
+        vec2 center = {width * 0.5f, height * 0.5f};
+        for (i32 s = 1; s < dfa.num_states; s++)
+        {
+            f32 angle = 2.0f * PI * (s - 1) / count;
+            NODE_KIND kind = dfa.is_accepting(s) ? GOAL : NORMAL;
+            if ((u32)s == dfa.start) kind = kind == GOAL ? INIT_GOAL : INIT;
+            nodes.place(s, kind, center + vec2{cosf(angle) * ring, sinf(angle) * ring}, NODE_MIN_SIZE * 0.5f);
+        }
+        // One arc per target, labelled with every byte leading there.
+        std::vector<ByteSet> bytes_to(dfa.num_states, ByteSet{});
+        std::vector<u32> targets;
+        for (i32 s = 1; s < dfa.num_states; s++)
         {
-            if (!nodes[i])
+            for (i32 c = 0; c < ALPHABET_SIZE; c++)
             {
-                id = i;
-                break;
+                u32 to = dfa.next(s, (u8)c);
+                if (to == DEAD_STATE) continue;
+                if (ByteSetEmpty(bytes_to[to])) targets.push_back(to);
+                BitsetSet(bytes_to[to].data(), c);
+            }
+            for (u32 to: targets)
+            {
+                nodes.add_arc(s, to, bytes_to[to]);
+                bytes_to[to] = {};
             }
+            targets.clear();
         }
-        return id;
+        canvas_replaced();
     }
 
-    i32 add( Node &&node ){
-        i32 id = get_empty();
-        nodes[id] = node; 
-        return id;
+    // Columns by distance from the start state, so the pattern reads left
+    // to right.
+    void load_regex(const RegexGraph& graph)
+    {
+        std::vector<std::vector<i32>> out(graph.num_states);
+        for (const auto& a: graph.arcs) out[a.from].push_back(a.to);
+        std::vector<i32> column(graph.num_states, -1);
+        std::vector<i32> order = {0};
+        column[0] = 0;
+        for (size_t head = 0; head < order.size(); head++)
+        {
+            for (i32 to: out[order[head]])
+            {
+                if (column[to] >= 0) continue;
+                column[to] = column[order[head]] + 1;
+                order.push_back(to);
+            }
+        }
+        i32 columns = 1;
+        for (i32 s = 0; s < graph.num_states; s++) columns = std::max(columns, column[s] + 2);
+        for (i32 s = 0; s < graph.num_states; s++) if (column[s] < 0) column[s] = columns - 1;
+
+        std::vector<i32> row(graph.num_states), rows_in(columns, 0);
+        for (i32 s = 0; s < graph.num_states; s++) row[s] = rows_in[column[s]]++;
+
+        nodes.clear();
+        mouse.selected_node = {};
+        f32 dx = fmax((width - NODE_MIN_SIZE) / (f32)columns, NODE_MIN_SIZE * 1.5f);
+        f32 dy = NODE_MIN_SIZE * 1.5f;
+        for (i32 s = 0; s < graph.num_states; s++)
+        {
+            NODE_KIND kind = graph.accepting[s] ? GOAL : NORMAL;
+            if (s == 0) kind = kind == GOAL ? INIT_GOAL : INIT;
+            vec2 position = {NODE_MIN_SIZE + column[s] * dx, height * 0.5f + (row[s] - (rows_in[column[s]] - 1) * 0.5f) * dy};
+            nodes.place(s + 1, kind, position, NODE_MIN_SIZE * 0.5f);
+        }
+        for (const auto& a: graph.arcs)
+        {
+            bool epsilon = a.bytes == REGEX_EPSILON;
+            nodes.add_arc(a.from + 1, a.to + 1, epsilon ? ByteSet{} : graph.sets[a.bytes], epsilon);
+        }
+        canvas_replaced();
+    }
+
+    // Everything derived from the old canvas is rebuilt. A simulation in
+    // progress starts over, otherwise it would keep stepping the old
+    // automaton and lighting up node ids that now mean other nodes.
+    void canvas_replaced()
+    {
+        tests.invalidate_all();
+        csr.nodes_changed();
+        reach.rebuild(csr.get(nodes));
+        if (state == SIMULATE)
+        {
+            sim_playing = false;
+            sim.reset(csr.get(nodes), sim_input);
+        }
     }
 };
 
 constexpr auto SCR_WIDTH = 500;
 constexpr auto SCR_HEIGHT = 500;
 
-constexpr auto NODE_MIN_SIZE = 50;
 constexpr auto LINES_THIKNESS = 2;
 constexpr auto ARC_LABEL_FONT_SIZE = 30;
-constexpr auto MAX_NUM_ARROWS_PER_NODE = 10;
+constexpr auto SIM_MIN_RATE = 1.0f;
+constexpr auto SIM_MAX_RATE = 1000000.0f;
+constexpr auto WORDS_PER_FRAME = 256;
 
 
 void Input(App& app);
 void Draw(App& app);
 vec2 GetMousePositionV();
-void DrawArrow(vec2 start, vec2 end, const char arc_val);
-void DrawArrowCatmull(vec2 v1, f32 r1, vec2 v2, f32 r2, f32 v_offset, const char val);
-void DrawConflictingArrows(App &app, i32 current_idx, std::vector<arc> arcs, std::array<bool, MAX_NUM_ARROWS_PER_NODE> &already_drawn);
+void DrawArrow(vec2 start, vec2 end, const char* label, Color color = ARC_COLOR);
+void DrawPanels(App& app);
+void ExportCpp(App& app);
+void DeterminizeCanvas(App& app);
+void MinimizeCanvas(App& app);
+void AdvanceSimulation(App& app);
+void DrawSimulationPanel(App& app);
+void DrawTestsPanel(App& app);
+void DrawWordsPanel(App& app);
+void StartEnumeration(App& app);
+void DrawScanPanel(App& app);
+void ScanInputFile(App& app);
+void FindMatchesInFile(App& app);
+void ClassifyLines(App& app);
+std::string_view MapInput(const std::string& path, MappingGuard& mapping, std::string& copy);
+void SaveCanvas(App& app);
+void LoadCanvas(App& app);
+void CompareWithOther(App& app);
+void BuildRegex(App& app);
+void CopyAsRegex(App& app);
+std::string ArcLabel(const arc& a);
+void CheckIncludedInOther(App& app);
+void CombineWithOther(App& app, PRODUCT_OP op);
+int ResizeStringCallback(ImGuiInputTextCallbackData* data);
+Color ArcColor(const App& app, const arc& a);
+void DrawArrowCatmull(vec2 v1, f32 r1, vec2 v2, f32 r2, f32 v_offset, const char* label, Color color = ARC_COLOR);
+void DrawConflictingArrows(App &app, i32 current_idx, const std::vector<arc>& arcs, std::vector<bool> &already_drawn);
 
 int main(void)
 {
@@ -212,6 +331,16 @@ int main(void)
     app.width = SCR_WIDTH;
     app.height = SCR_HEIGHT;
     InitWindow(app.width, app.height, "PAINTOMATRON");
+    rlImGuiSetup(true);
+    strcpy(app.export_path, "automaton.h");
+    app.sim_rate = 10.0f;
+    strcpy(app.file_path, "automaton.pta");
+    strcpy(app.other_path, "other.pta");
+    app.test_expect = true;
+    app.words_accepted = true;
+    app.words_limit = 100;
+    strcpy(app.scan_path, "input.txt");
+    app.reach.rebuild(app.graph());
 
     SetTargetFPS(60);
 
@@ -226,13 +355,14 @@ int main(void)
 
     }
 
+    rlImGuiShutdown();
     CloseWindow();
 
     return 0;
 }
 
 
-void DrawArrowCatmull(vec2 v1, f32 r1, vec2 v2, f32 r2, f32 v_offset, const char val)
+void DrawArrowCatmull(vec2 v1, f32 r1, vec2 v2, f32 r2, f32 v_offset, const char* label, Color color)
 {
     Vector2 temp[5];
 
@@ -260,7 +390,7 @@ void DrawArrowCatmull(vec2 v1, f32 r1, vec2 v2, f32 r2, f32 v_offset, const char
     temp[1] = {v1.x + trans1.x, v1.y + trans1.y};
     temp[3] = {v2.x + trans2.x, v2.y + trans2.y};
     temp[4] = {v2.x , v2.y };
-    DrawSplineBezierCubic(temp, 5, LINES_THIKNESS, ARC_COLOR);
+    DrawSplineBezierCubic(temp, 5, LINES_THIKNESS, color);
 
     // Draw Triangle
     direction = Vec2Dir({temp[4].x - temp[3].x, temp[4].y - temp[3].y});
@@ -274,20 +404,32 @@ void DrawArrowCatmull(vec2 v1, f32 r1, vec2 v2, f32 r2, f32 v_offset, const char
     right = Vec2xScalar(right, ARROW_LENGTH) + vec2{temp[3].x, temp[3].y};
 
 
-    DrawTriangle({temp[3].x, temp[3].y}, {left.x, left.y}, {right.x, right.y}, ARC_COLOR);
+    DrawTriangle({temp[3].x, temp[3].y}, {left.x, left.y}, {right.x, right.y}, color);
 
-    char temp_str[2];
-    temp_str[0] = val;
-    temp_str[1] = '\0';
-    DrawText(temp_str, midpoint.x, midpoint.y + 10, ARC_LABEL_FONT_SIZE, TEXT_COLOR);
+    DrawText(label, midpoint.x, midpoint.y + 10, ARC_LABEL_FONT_SIZE, TEXT_COLOR);
 }
 
 
 void Input(App& app)
 {
-    if (IsKeyPressed(KEY_S)) app.state = SELECT;
-    if (IsKeyPressed(KEY_C)) app.state = CREATE;
-    if (IsKeyPressed(KEY_R)) app.state = RELATION;
+    if (app.state == SIMULATE) AdvanceSimulation(app);
+
+    ImGuiIO& io = ImGui::GetIO();
+    if (io.WantCaptureMouse || io.WantCaptureKeyboard) return;
+
+    // Letters typed into an arc label are label text, not mode switches.
+    if (app.state != WRITE)
+    {
+        if (IsKeyPressed(KEY_S)) app.state = SELECT;
+        if (IsKeyPressed(KEY_C)) app.state = CREATE;
+        if (IsKeyPressed(KEY_R)) app.state = RELATION;
+        if (IsKeyPressed(KEY_M))
+        {
+            app.state = SIMULATE;
+            app.sim_playing = false;
+            app.sim.reset(app.graph(), app.sim_input);
+        }
+    }
 
     switch (app.state)
     {
@@ -320,22 +462,50 @@ void Input(App& app)
                     size, size
                 };
 
-                app.add({
+                i32 id = app.nodes.add(
                     NORMAL, 
                     {rect.x + 0.5f * rect.width, rect.y + 0.5f * rect.height},
-                    rect.width * 0.5f, {}
-                });
+                    rect.width * 0.5f
+                );
+                app.csr.node_added(id, NORMAL);
             }
         }
     } break;
     case WRITE: {      
-        if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) app.state = SELECT;
+        if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT) || IsKeyPressed(KEY_ENTER)) app.state = SELECT;
         int key = GetCharPressed();
-        if (key > 0)
+        arc* selected = app.get_arc_selected();
+        if (!selected)
         {
-            app.nodes[app.mouse.selected_arc_info.node_id].arcs[app.mouse.selected_arc_info.other_id].val = key;
             app.state = SELECT;
         }
+        else if (key > 0 || IsKeyPressed(KEY_BACKSPACE))
+        {
+            // The label follows the text as it is typed, read as the inside
+            // of a class: a, a-z0-9, ^\n. No text left makes an empty move.
+            if (key > 0) app.arc_text += (char)key;
+            else if (!app.arc_text.empty()) app.arc_text.pop_back();
+            try
+            {
+                if (app.arc_text.empty())
+                {
+                    selected->epsilon = true;
+                }
+                else
+                {
+                    selected->bytes = ParseByteSet(app.arc_text);
+                    selected->epsilon = false;
+                }
+                app.tests.invalidate_node(selected->info.node_id);
+                app.csr.arcs_changed(selected->info.node_id);
+            }
+            catch (const std::runtime_error& e)
+            {
+                // Half typed, such as a trailing backslash; the label stays
+                // as it was until the text reads again.
+                app.message = e.what();
+            }
+        }
         
 
 
@@ -344,66 +514,74 @@ void Input(App& app)
         if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT))
         {
             i32 new_idx = app.check_collision(GetMousePositionV());
-            if (new_idx != app.mouse.selected_node_idx)
-                app.mouse.selected_node_idx = new_idx;
-            if (app.mouse.selected_node_idx == 0)
+            app.mouse.selected_node = app.nodes.handle(new_idx);
+            if (new_idx == 0)
             {
-                app.mouse.selected_arc_info = app.check_arc_collision(GetMousePositionV()); 
-                if (app.mouse.selected_arc_info.node_id != 0) { app.state = WRITE; }
+                arc_info hit = app.check_arc_collision(GetMousePositionV()); 
+                if (hit.node_id != 0)
+                {
+                    app.mouse.selected_arc_owner = app.nodes.handle(hit.node_id);
+                    app.mouse.selected_arc = hit.other_id;
+                    app.arc_text.clear();
+                    app.state = WRITE;
+                }
             }
         } 
 
-        Node* pnode = app.get_node_selected();
-        if (IsMouseButtonPressed(MOUSE_BUTTON_RIGHT) && *pnode)
+        i32 selected = app.get_node_selected();
+        if (IsMouseButtonPressed(MOUSE_BUTTON_RIGHT) && selected)
         {
-            pnode->kind = next_node_kind(pnode->kind);
+            NODE_KIND old_kind = app.nodes.kind[selected];
+            app.nodes.kind[selected] = next_node_kind(old_kind);
+            app.reach.change_kind(selected, old_kind, app.nodes.kind[selected]);
+            app.csr.kind_changed(selected, app.nodes.kind[selected]);
+            // A new INIT node is not in any trace yet.
+            if (IsInitial(app.nodes.kind[selected])) app.tests.invalidate_all();
+            else app.tests.invalidate_node(selected);
         }
 
-        if (IsMouseButtonDown(MOUSE_BUTTON_LEFT) && *pnode)
+        if (IsMouseButtonDown(MOUSE_BUTTON_LEFT) && selected)
         {
-            pnode->position = GetMousePositionV();
+            app.nodes.position[selected] = GetMousePositionV();
         }
 
 
-        if (IsKeyReleased(KEY_D) && *pnode)
+        if (IsKeyReleased(KEY_D) && selected)
         {
-            app.delete_arcs_to_id(app.mouse.selected_node_idx);
-            app.mouse.selected_node_idx = 0;
-            pnode->kind = NIL;
+            app.reach.remove_node(selected);
+            app.tests.invalidate_node(selected);
+            app.mouse.selected_node = {};
+            app.nodes.remove(selected);
+            app.csr.nodes_changed();
         }
     } break;
     case RELATION:{
         if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT))
         {
-            Node *pnode = app.get_node_selected();
-            if (*pnode)
+            i32 selected = app.get_node_selected();
+            if (selected)
             {
                 i32 id = app.check_collision(GetMousePositionV());
-                if (app.nodes[id])
+                if (app.nodes.alive(id))
                 {
-                    auto& other = app.nodes[id];
-                    bool other_has_arc = false;
-                    for (const auto& arc: other.arcs)
-                    {
-                        if (arc.info.other_id == app.mouse.selected_node_idx || arc.info.node_id == app.mouse.selected_node_idx)
-                        {
-                            other_has_arc = true;
-                            break;
-                        }
-                    }
-                    if (other_has_arc)
-                        other.add_arc(app.mouse.selected_node_idx, id);
-                    else
-                        pnode->add_arc(app.mouse.selected_node_idx, id);
+                    ByteSet label = {};
+                    BitsetSet(label.data(), 'A');
+                    app.nodes.add_arc(selected, id, label);
+                    app.tests.invalidate_node(selected);
+                    app.reach.add_arc(selected, id);
+                    app.csr.arcs_changed(selected);
                 }
-                app.mouse.selected_node_idx = 0;
+                app.mouse.selected_node = {};
             }
             else
             {
-                app.mouse.selected_node_idx = app.check_collision(GetMousePositionV());
+                app.mouse.selected_node = app.nodes.handle(app.check_collision(GetMousePositionV()));
             }
         } 
     } break;
+    case SIMULATE: {
+        // Stepping happens in AdvanceSimulation, the canvas is read only.
+    } break;
     }
 }
 void Draw(App& app)
@@ -411,35 +589,37 @@ void Draw(App& app)
     BeginDrawing();
     ClearBackground(BACKGROUND_COLOR);
     
-    std::array<bool, MAX_NUM_ARROWS_PER_NODE> already_drawn;
-    for (int i = 1; i < app.nodes.size(); i++)
+    std::vector<bool> already_drawn;
+    for (i32 i: app.nodes.live)
     {
-        const auto& node = app.nodes[i];
-        if (node)
+        vec2 position = app.nodes.position[i];
+        f32 radius = app.nodes.radius[i];
+        NODE_KIND kind = app.nodes.kind[i];
+        const auto& arcs = app.nodes.arcs[i];
+
+        bool active = app.state == SIMULATE && app.sim.node_active(i);
+        // Greyed when no accepted word can pass through it.
+        bool useful = app.reach.reachable(i) && app.reach.live(i);
+        DrawCircle(position.x, position.y, radius, active ? NODE_ACTIVE_COLOR : useful ? NODE_COLOR_A : NODE_USELESS_COLOR);
+        DrawCircleLines(position.x, position.y, radius, NODE_COLOR_B);
+
+        if (IsAccepting(kind))
+            DrawCircleLines(position.x, position.y, NODE_MIN_SIZE, NODE_COLOR_B);
+        if (IsInitial(kind))
         {
-            DrawCircle(node.position.x, node.position.y, node.radius, NODE_COLOR_A);
-            DrawCircleLines(node.position.x, node.position.y, node.radius, NODE_COLOR_B);
-
-            if (node.kind == GOAL)
-                DrawCircleLines(node.position.x, node.position.y, NODE_MIN_SIZE, NODE_COLOR_B);
-            else if (node.kind == INIT)
-            {
-                vec2 arrow_start = {node.position.x - node.radius - ARROW_INIT_OFFSET, node.position.y}; 
-                DrawArrow(arrow_start, {arrow_start.x + ARROW_INIT_OFFSET, arrow_start.y}, ' ');
-            }
-            char buff[4];
-            sprintf_s(buff, "q%d", i);
-            DrawText(buff, node.position.x, node.position.y, ARC_LABEL_FONT_SIZE, TEXT_COLOR);
-            already_drawn = { 0 };
+            vec2 arrow_start = {position.x - radius - ARROW_INIT_OFFSET, position.y}; 
+            DrawArrow(arrow_start, {arrow_start.x + ARROW_INIT_OFFSET, arrow_start.y}, " ");
+        }
+        char buff[16];
+        sprintf_s(buff, "q%d", i);
+        DrawText(buff, position.x, position.y, ARC_LABEL_FONT_SIZE, TEXT_COLOR);
+        already_drawn.assign(arcs.size(), false);
 
-            for (int k = 0; k < node.arcs.size(); k++)
-            {
-                const auto& arc = node.arcs[k];
-                Node endnode = app.nodes[arc.info.other_id];
-                if (!endnode) 
-                    continue;
-                DrawConflictingArrows(app, k, node.arcs, already_drawn);
-            }
+        for (int k = 0; k < arcs.size(); k++)
+        {
+            if (!app.nodes.alive(arcs[k].info.other_id)) 
+                continue;
+            DrawConflictingArrows(app, k, arcs, already_drawn);
         }
     }
     
@@ -460,10 +640,12 @@ void Draw(App& app)
         DrawCircleLines(rect.x + 0.5f * rect.width, rect.y + 0.5f * rect.height, rect.width * 0.5f, NODE_COLOR_B);
     }
 
-    Node *pnode = app.get_node_selected();
-    if (*pnode)
+    i32 selected = app.get_node_selected();
+    if (selected)
     {
-        DrawRectangleLines(pnode->position.x - pnode->radius, pnode->position.y - pnode->radius, pnode->radius * 2, pnode->radius * 2, RED);
+        vec2 position = app.nodes.position[selected];
+        f32 radius = app.nodes.radius[selected];
+        DrawRectangleLines(position.x - radius, position.y - radius, radius * 2, radius * 2, RED);
     }
 
     
@@ -488,7 +670,14 @@ void Draw(App& app)
         case WRITE:{
             DrawText("W", Xpos + 6, Ypos, Size, TEXT_COLOR);
         }break;
+        case SIMULATE:{
+            DrawText("M", Xpos + 6, Ypos, Size, TEXT_COLOR);
+        }break;
     }
+
+    rlImGuiBegin();
+    DrawPanels(app);
+    rlImGuiEnd();
     EndDrawing();
 
 }
@@ -501,15 +690,12 @@ vec2 GetMousePositionV()
 }
 
 
-void DrawArrow(vec2 start, vec2 end, const char arc_val)
+void DrawArrow(vec2 start, vec2 end, const char* label, Color color)
 {
-    DrawLineEx({start.x, start.y}, {end.x, end.y}, LINES_THIKNESS, ARC_COLOR);
+    DrawLineEx({start.x, start.y}, {end.x, end.y}, LINES_THIKNESS, color);
     vec2 midpos = {(start.x + end.x) * 0.5f, (start.y + end.y) * 0.5f};
     midpos.y -= 40;
-    char temp_str[2];
-    temp_str[0] = arc_val;
-    temp_str[1] = '\0';
-    DrawText(temp_str, midpos.x, midpos.y, ARC_LABEL_FONT_SIZE, TEXT_COLOR);
+    DrawText(label, midpos.x, midpos.y, ARC_LABEL_FONT_SIZE, TEXT_COLOR);
 
 
     vec2 direction = Vec2Dir(end - start);
@@ -523,21 +709,21 @@ void DrawArrow(vec2 start, vec2 end, const char arc_val)
     right = Vec2xScalar(right, ARROW_LENGTH) + end;
     
     
-    DrawTriangle({end.x, end.y}, {left.x, left.y}, {right.x, right.y}, ARC_COLOR);
+    DrawTriangle({end.x, end.y}, {left.x, left.y}, {right.x, right.y}, color);
 
 }
 
-void DrawConflictingArrows(App &app, i32 current_idx, std::vector<arc> arcs, std::array<bool, MAX_NUM_ARROWS_PER_NODE>& already_drawn)
+void DrawConflictingArrows(App &app, i32 current_idx, const std::vector<arc>& arcs, std::vector<bool>& already_drawn)
 {
-    arc arcs_to_draw[20];
+    std::vector<arc> arcs_to_draw(arcs.size() + 1);
     int arcs_to_draw_idx = 0;
     int start_index = 0;
 
-    auto &current = arcs[current_idx];
+    const auto &current = arcs[current_idx];
     for(int i = 0; i < arcs.size(); i++)
     {
        if (already_drawn[i]) continue;
-       auto &other = arcs[i];
+       const auto &other = arcs[i];
        bool point_same = (other.info.other_id == current.info.other_id && other.info.node_id == current.info.node_id);
        bool point_other = (other.info.other_id == current.info.node_id && other.info.node_id == current.info.other_id);
        if (point_other || point_same)
@@ -546,29 +732,32 @@ void DrawConflictingArrows(App &app, i32 current_idx, std::vector<arc> arcs, std
             arcs_to_draw_idx +=1;
        }
     }
-    const auto& start = app.nodes[current.info.node_id];
-    const auto& end = app.nodes[current.info.other_id];
+    i32 start = current.info.node_id;
+    i32 end = current.info.other_id;
+    bool both_alive = app.nodes.alive(start) && app.nodes.alive(end);
+    f32 start_radius = both_alive ? app.nodes.radius[start] : 0;
+    f32 end_radius = both_alive ? app.nodes.radius[end] : 0;
 
-    vec2 startpos = start.position;
-    vec2 endpos = end.position;
+    vec2 startpos = both_alive ? app.nodes.position[start] : vec2{};
+    vec2 endpos = both_alive ? app.nodes.position[end] : vec2{};
 
     if((arcs_to_draw_idx % 2 != 0 || arcs_to_draw_idx == 1) && current.info.other_id != current.info.node_id)
     {
         already_drawn[current_idx] = true;
         start_index += 1;
 
-        if (start && end)
+        if (both_alive)
         {
             vec2 direction = Vec2Dir(endpos - startpos);
-            startpos.x += direction.x * start.radius;
-            startpos.y += direction.y * start.radius;
+            startpos.x += direction.x * start_radius;
+            startpos.y += direction.y * start_radius;
 
-            endpos.x -= direction.x * end.radius;
-            endpos.y -= direction.y * end.radius;
+            endpos.x -= direction.x * end_radius;
+            endpos.y -= direction.y * end_radius;
 
 
-            vec2 line_end = end.position - Vec2xScalar(direction, end.radius+ 5);
-            DrawArrow(startpos, line_end, current.val);
+            vec2 line_end = app.nodes.position[end] - Vec2xScalar(direction, end_radius+ 5);
+            DrawArrow(startpos, line_end, ArcLabel(current).c_str(), ArcColor(app, current));
         }
     } 
     else if (current.info.other_id == current.info.node_id)
@@ -576,30 +765,28 @@ void DrawConflictingArrows(App &app, i32 current_idx, std::vector<arc> arcs, std
         already_drawn[current_idx] = true;
         start_index += 1;
         
-        if (start && end)
+        if (both_alive)
         {
             Vector2 temp[5];
             f32 angle =  30.0f * DEG2RAD;
 
             vec2 right = { 0 * cosf(angle) - (-1 * sinf(angle)), 0 * sinf(angle) + (-1 * cosf(angle))};
             vec2 left = { 0 * cosf(-angle) - (-1 * sinf(-angle)), (0 * sinf(-angle)) + (-1 * cosf(-angle))};
-            right = Vec2xScalar(right, end.radius) + startpos;
-            left = Vec2xScalar(left, end.radius) + startpos;
+            right = Vec2xScalar(right, end_radius) + startpos;
+            left = Vec2xScalar(left, end_radius) + startpos;
 
-            vec2 midpos = {startpos.x, startpos.y - ARC_SELF_RELATION_OFFSET - start.radius}; 
+            vec2 midpos = {startpos.x, startpos.y - ARC_SELF_RELATION_OFFSET - start_radius}; 
             temp[0] = {startpos.x, startpos.y};
             temp[1] = {left.x, left.y};
             temp[2] = {midpos.x, midpos.y};
             temp[3] = {right.x, right.y};
             temp[4] = {startpos.x, startpos.y};
-            DrawSplineCatmullRom(temp, 5, LINES_THIKNESS, ARC_COLOR);
+            Color color = ArcColor(app, current);
+            DrawSplineCatmullRom(temp, 5, LINES_THIKNESS, color);
 
-            char temp_str[2];
-            temp_str[0] = current.val;
-            temp_str[1] = '\0';
-            DrawText(temp_str, midpos.x, midpos.y + 10, ARC_LABEL_FONT_SIZE, TEXT_COLOR);
+            DrawText(ArcLabel(current).c_str(), midpos.x, midpos.y + 10, ARC_LABEL_FONT_SIZE, TEXT_COLOR);
 
-            DrawTriangle({right.x, right.y},  {right.x + 20, right.y - 20}, {right.x - 20, right.y - 20}, ARC_COLOR);
+            DrawTriangle({right.x, right.y},  {right.x + 20, right.y - 20}, {right.x - 20, right.y - 20}, color);
         }
     }
 
@@ -613,12 +800,569 @@ void DrawConflictingArrows(App &app, i32 current_idx, std::vector<arc> arcs, std
         {
             v_offset = -v_offset;
         }
-        const Node& nodeA = app.nodes[arcs_to_draw[i].info.node_id];
-        const Node& nodeB = app.nodes[arcs_to_draw[i].info.other_id];
-        if (nodeA && nodeB)
-            DrawArrowCatmull(nodeA.position, nodeA.radius, nodeB.position, nodeB.radius, v_offset, arcs_to_draw[i].val);
+        i32 a = arcs_to_draw[i].info.node_id;
+        i32 b = arcs_to_draw[i].info.other_id;
+        if (app.nodes.alive(a) && app.nodes.alive(b))
+            DrawArrowCatmull(app.nodes.position[a], app.nodes.radius[a], app.nodes.position[b], app.nodes.radius[b], v_offset, ArcLabel(arcs_to_draw[i]).c_str(), ArcColor(app, arcs_to_draw[i]));
 
         already_drawn[i] = true;
     }
 }
 
+
+
+int ResizeStringCallback(ImGuiInputTextCallbackData* data)
+{
+    if (data->EventFlag == ImGuiInputTextFlags_CallbackResize)
+    {
+        std::string* str = (std::string*)data->UserData;
+        str->resize(data->BufTextLen);
+        data->Buf = &(*str)[0];
+    }
+    return 0;
+}
+
+void DrawPanels(App& app)
+{
+    ImGui::Begin("COMMANDS");
+
+    ImGui::InputText("Path", app.export_path, sizeof(app.export_path));
+    ImGui::Checkbox("constexpr", &app.export_constexpr);
+    if (ImGui::Button("Export as C++")) ExportCpp(app);
+    if (ImGui::Button("Determinize")) DeterminizeCanvas(app);
+    ImGui::SameLine();
+    if (ImGui::Button("Minimize")) MinimizeCanvas(app);
+
+    ImGui::Separator();
+    ImGui::InputText("Regex", app.regex, sizeof(app.regex));
+    ImGui::Checkbox("Thompson", &app.regex_thompson);
+    ImGui::SameLine();
+    if (ImGui::Button("Build")) BuildRegex(app);
+    ImGui::SameLine();
+    if (ImGui::Button("Copy as regex")) CopyAsRegex(app);
+
+    ImGui::Separator();
+    ImGui::InputText("File", app.file_path, sizeof(app.file_path));
+    if (ImGui::Button("Save")) SaveCanvas(app);
+    ImGui::SameLine();
+    if (ImGui::Button("Load")) LoadCanvas(app);
+
+    ImGui::Separator();
+    ImGui::InputText("Other", app.other_path, sizeof(app.other_path));
+    if (ImGui::Button("Equivalent?")) CompareWithOther(app);
+    ImGui::SameLine();
+    if (ImGui::Button("Included?")) CheckIncludedInOther(app);
+    if (ImGui::Button("Intersect")) CombineWithOther(app, PRODUCT_INTERSECTION);
+    ImGui::SameLine();
+    if (ImGui::Button("Union")) CombineWithOther(app, PRODUCT_UNION);
+    ImGui::SameLine();
+    if (ImGui::Button("Difference")) CombineWithOther(app, PRODUCT_DIFFERENCE);
+    ImGui::SameLine();
+    ImGui::Checkbox("To canvas", &app.product_to_canvas);
+
+    if (app.state == SIMULATE) DrawSimulationPanel(app);
+
+    if (!app.message.empty())
+    {
+        ImGui::Separator();
+        ImGui::TextWrapped("%s", app.message.c_str());
+    }
+    ImGui::End();
+
+    DrawTestsPanel(app);
+    DrawWordsPanel(app);
+    DrawScanPanel(app);
+}
+
+void DrawSimulationPanel(App& app)
+{
+    ImGui::Separator();
+    ImGui::InputText("Input", &app.sim_input[0], app.sim_input.capacity() + 1, ImGuiInputTextFlags_CallbackResize, ResizeStringCallback, &app.sim_input);
+    if (ImGui::Button("Reset")) 
+    {
+        app.sim_playing = false;
+        app.sim.reset(app.graph(), app.sim_input);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Step")) app.sim.step(1);
+    ImGui::SameLine();
+    if (ImGui::Button(app.sim_playing ? "Pause" : "Play")) app.sim_playing = !app.sim_playing;
+    ImGui::SliderFloat("Symbols/s", &app.sim_rate, SIM_MIN_RATE, SIM_MAX_RATE, "%.0f", ImGuiSliderFlags_Logarithmic);
+
+    ImGui::Text("%zu / %zu  %s", app.sim.pos, app.sim.input.size(), app.sim.accepting() ? "ACCEPT" : "REJECT");
+}
+
+void AdvanceSimulation(App& app)
+{
+    if (!app.sim_playing) return;
+    if (app.sim.done())
+    {
+        app.sim_playing = false;
+        return;
+    }
+
+    // Only the symbols due this frame are stepped.
+    app.sim_budget += GetFrameTime() * app.sim_rate;
+    size_t steps = (size_t)app.sim_budget;
+    app.sim_budget -= (f32)steps;
+    app.sim.step(steps);
+}
+
+void DrawTestsPanel(App& app)
+{
+    if (app.tests.any_dirty) app.tests.rerun(app.graph());
+
+    ImGui::Begin("TESTS");
+    ImGui::Text("%d / %zu passing", app.tests.passed(), app.tests.tests.size());
+
+    ImGui::InputText("Label", app.test_label, sizeof(app.test_label));
+    ImGui::InputText("String", &app.test_input[0], app.test_input.capacity() + 1, ImGuiInputTextFlags_CallbackResize, ResizeStringCallback, &app.test_input);
+    ImGui::Checkbox("Accept", &app.test_expect);
+    ImGui::SameLine();
+    if (ImGui::Button("Add")) app.tests.add(app.test_label, app.test_input, app.test_expect);
+    ImGui::Separator();
+
+    i32 remove = -1;
+    ImGuiListClipper clipper;
+    clipper.Begin((i32)app.tests.tests.size());
+    while (clipper.Step())
+    {
+        for (i32 i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
+        {
+            const TestCase& test = app.tests.tests[i];
+            bool pass = test.accepted == test.expect_accept;
+            ImGui::PushID(i);
+            ImGui::TextColored(pass ? ImVec4(0.3f, 0.9f, 0.3f, 1.0f) : ImVec4(0.9f, 0.3f, 0.3f, 1.0f), pass ? "PASS" : "FAIL");
+            ImGui::SameLine();
+            ImGui::Text("%s  %s  \"%s\"", test.label.c_str(), test.expect_accept ? "accept" : "reject", test.input.c_str());
+            ImGui::SameLine();
+            if (ImGui::SmallButton("X")) remove = i;
+            ImGui::PopID();
+        }
+    }
+    if (remove >= 0) app.tests.remove(remove);
+    ImGui::End();
+}
+
+void DrawWordsPanel(App& app)
+{
+    // Results stream in a few hundred per frame.
+    std::string word;
+    for (i32 i = 0; i < WORDS_PER_FRAME && app.words.next(&word); i++) app.word_list.push_back(EscapeBytes(word));
+
+    ImGui::Begin("WORDS");
+    if (ImGui::RadioButton("Accepted", app.words_accepted)) app.words_accepted = true;
+    ImGui::SameLine();
+    if (ImGui::RadioButton("Rejected", !app.words_accepted)) app.words_accepted = false;
+    ImGui::InputInt("Limit", &app.words_limit);
+    if (ImGui::Button("Enumerate")) StartEnumeration(app);
+    ImGui::SameLine();
+    const char* status = !app.words.done() ? "..." : app.words.found < app.words.limit && app.words.truncated() ? " (QUEUE FULL)" : "";
+    ImGui::Text("%zu words%s, %zu KB", app.word_list.size(), status, app.words.bytes() / 1024);
+    ImGui::Separator();
+
+    ImGuiListClipper clipper;
+    clipper.Begin((i32)app.word_list.size());
+    while (clipper.Step())
+    {
+        for (i32 i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) ImGui::TextUnformatted(app.word_list[i].c_str());
+    }
+    ImGui::End();
+}
+
+void StartEnumeration(App& app)
+{
+    try
+    {
+        if (app.words_limit < 1) app.words_limit = 1;
+        app.word_list.clear();
+        app.words = MakeWordEnumerator(CompileDeterministic(app.graph()), app.words_accepted, (u32)app.words_limit);
+    }
+    catch (const std::runtime_error& e)
+    {
+        app.message = e.what();
+        V_LOG_ERROR(e.what());
+    }
+}
+
+void DrawScanPanel(App& app)
+{
+    ImGui::Begin("SCAN");
+    ImGui::InputText("Input file", app.scan_path, sizeof(app.scan_path));
+    if (ImGui::RadioButton("DFA", !app.scan_lazy)) app.scan_lazy = false;
+    ImGui::SameLine();
+    if (ImGui::RadioButton("Lazy DFA", app.scan_lazy)) app.scan_lazy = true;
+    // The lazy cache is filled by one thread.
+    ImGui::BeginDisabled(app.scan_lazy);
+    ImGui::InputInt("Threads", &app.scan_threads);
+    ImGui::EndDisabled();
+    if (app.scan_threads < 0) app.scan_threads = 0;
+    if (ImGui::Button("Accepts?")) ScanInputFile(app);
+    ImGui::SameLine();
+    // Only the compiled automaton reports match offsets.
+    ImGui::BeginDisabled(app.scan_lazy);
+    if (ImGui::Button("Matches")) FindMatchesInFile(app);
+    ImGui::EndDisabled();
+    ImGui::SameLine();
+    if (ImGui::Button("Classify lines")) ClassifyLines(app);
+    ImGui::End();
+}
+
+// Regular files are mapped rather than copied, so inputs larger than memory
+// still scan. What can not be mapped (empty files, pipes) is read whole.
+std::string_view MapInput(const std::string& path, MappingGuard& mapping, std::string& copy)
+{
+    mapping.file = MapFile(path);
+    if (mapping.file.data) return std::string_view(mapping.file.data, mapping.file.size);
+    copy = LoadFile(path);
+    return copy;
+}
+
+// The whole file is one input, split across scan_threads. The lazy engine
+// skips the subset construction, which can blow up on some canvases.
+void ScanInputFile(App& app)
+{
+    try
+    {
+        MappingGuard mapping = {};
+        std::string copy;
+        std::string_view input = MapInput(app.scan_path, mapping, copy);
+        bool accepted;
+        std::string stats;
+        if (app.scan_lazy)
+        {
+            Nfa nfa = CompileNfa(app.graph());
+            LazyDfa lazy = MakeLazyDfa(nfa);
+            auto begin = std::chrono::steady_clock::now();
+            accepted = lazy.accepts(input);
+            f64 ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - begin).count();
+            stats = std::to_string(ms) + " MS, " + std::to_string((i32)(lazy.stats.hit_rate() * 100.0)) + "% CACHE HITS, "
+                + std::to_string(lazy.stats.flushes) + " FLUSHES, " + std::to_string(lazy.stats.fallback_bytes / 1024) + " KB ON THE NFA";
+        }
+        else
+        {
+            Automaton dfa = CompileDeterministic(app.graph());
+            auto begin = std::chrono::steady_clock::now();
+            accepted = ParallelAccepts(dfa, input, app.scan_threads);
+            f64 ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - begin).count();
+            stats = std::to_string(ms) + " MS";
+        }
+
+        app.message = std::string(accepted ? "ACCEPTED: " : "REJECTED: ") + app.scan_path + ", "
+            + std::to_string(input.size() / 1024) + " KB IN " + stats;
+    }
+    catch (const std::runtime_error& e)
+    {
+        app.message = e.what();
+        V_LOG_ERROR(e.what());
+    }
+}
+
+struct MatchCount {
+    u64 count;
+    u64 first;  // end offset of the first match
+};
+
+static void CountMatch(u64 end_offset, void* user)
+{
+    MatchCount* matches = (MatchCount*)user;
+    if (matches->count++ == 0) matches->first = end_offset;
+}
+
+// ScanFile maps regular files and splits them across scan_threads; "-" and
+// pipes are read in pieces.
+void FindMatchesInFile(App& app)
+{
+    try
+    {
+        Automaton dfa = CompileDeterministic(app.graph());
+        MatchCount matches = {};
+        auto begin = std::chrono::steady_clock::now();
+        ScanFile(dfa, app.scan_path, CountMatch, &matches, app.scan_threads);
+        f64 ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+        app.message = std::to_string(matches.count) + " MATCHES IN " + app.scan_path;
+        if (matches.count) app.message += ", THE FIRST ENDING AT " + std::to_string(matches.first);
+        app.message += ", " + std::to_string(ms) + " MS";
+    }
+    catch (const std::runtime_error& e)
+    {
+        app.message = e.what();
+        V_LOG_ERROR(e.what());
+    }
+}
+
+// Every line of the file is one input. With the DFA the lines run through
+// AcceptsBatch and then one by one, so the two throughputs can be compared.
+void ClassifyLines(App& app)
+{
+    try
+    {
+        MappingGuard mapping = {};
+        std::string copy;
+        std::string_view file = MapInput(app.scan_path, mapping, copy);
+        std::vector<std::string_view> lines;
+        for (size_t begin = 0; begin < file.size();)
+        {
+            size_t end = file.find('\n', begin);
+            if (end == std::string_view::npos) end = file.size();
+            lines.push_back(file.substr(begin, end - begin));
+            begin = end + 1;
+        }
+        std::vector<u8> results(lines.size());
+
+        std::string stats;
+        if (app.scan_lazy)
+        {
+            Nfa nfa = CompileNfa(app.graph());
+            LazyDfa lazy = MakeLazyDfa(nfa);
+            auto begin = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < lines.size(); i++) results[i] = lazy.accepts(lines[i]);
+            f64 ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - begin).count();
+            stats = std::to_string(ms) + " MS, " + std::to_string((i32)(lazy.stats.hit_rate() * 100.0)) + "% CACHE HITS";
+        }
+        else
+        {
+            Automaton dfa = CompileDeterministic(app.graph());
+            auto begin = std::chrono::steady_clock::now();
+            AcceptsBatch(dfa, lines.data(), lines.size(), results.data());
+            f64 batch_ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+            begin = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < lines.size(); i++) results[i] = dfa.accepts(lines[i]);
+            f64 loop_ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - begin).count();
+            stats = "BATCH " + std::to_string(batch_ms) + " MS, LOOP " + std::to_string(loop_ms) + " MS";
+        }
+
+        size_t accepted = std::count(results.begin(), results.end(), 1);
+        app.message = std::to_string(accepted) + " / " + std::to_string(lines.size()) + " LINES ACCEPTED IN " + stats;
+    }
+    catch (const std::runtime_error& e)
+    {
+        app.message = e.what();
+        V_LOG_ERROR(e.what());
+    }
+}
+
+void SaveCanvas(App& app)
+{
+    try
+    {
+        SaveFile(app.file_path, SerializeCanvas(app.nodes, app.tests));
+        app.message = std::string("SAVED TO ") + app.file_path;
+    }
+    catch (const std::runtime_error& e)
+    {
+        app.message = e.what();
+        V_LOG_ERROR(e.what());
+    }
+}
+
+void LoadCanvas(App& app)
+{
+    try
+    {
+        ParseCanvas(LoadFile(app.file_path), app.nodes, &app.tests);
+        // Loading leaves SIMULATE and a half typed arc label behind.
+        app.state = SELECT;
+        app.canvas_replaced();
+        app.mouse.selected_node = {};
+        app.message = std::string("LOADED ") + app.file_path;
+    }
+    catch (const std::runtime_error& e)
+    {
+        app.message = e.what();
+        V_LOG_ERROR(e.what());
+    }
+}
+
+void BuildRegex(App& app)
+{
+    try
+    {
+        auto begin = std::chrono::steady_clock::now();
+        RegexGraph graph = CompileRegex(app.regex, app.regex_thompson ? REGEX_THOMPSON : REGEX_GLUSHKOV);
+        f64 ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - begin).count();
+        app.load_regex(graph);
+        app.message = "BUILT: " + std::to_string(graph.num_states) + " STATES, " + std::to_string(graph.arcs.size()) + " ARCS IN " + std::to_string(ms) + " MS";
+    }
+    catch (const std::runtime_error& e)
+    {
+        app.message = e.what();
+        V_LOG_ERROR(e.what());
+    }
+}
+
+void CopyAsRegex(App& app)
+{
+    try
+    {
+        auto begin = std::chrono::steady_clock::now();
+        std::string regex = CanvasToRegex(app.graph());
+        f64 ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - begin).count();
+        ImGui::SetClipboardText(regex.c_str());
+        app.message = "COPIED " + std::to_string(regex.size()) + " CHARACTERS IN " + std::to_string(ms) + " MS: " + regex.substr(0, 200);
+    }
+    catch (const std::runtime_error& e)
+    {
+        app.message = e.what();
+        V_LOG_ERROR(e.what());
+    }
+}
+
+std::string ArcLabel(const arc& a)
+{
+    // The default font has no epsilon glyph.
+    return a.epsilon ? "eps" : ByteSetText(a.bytes);
+}
+
+void CompareWithOther(App& app)
+{
+    try
+    {
+        NodeStore other = {};
+        ParseCanvas(LoadFile(app.other_path), other, nullptr);
+
+        auto begin = std::chrono::steady_clock::now();
+        EquivalenceResult result = CheckEquivalence(CompileNfa(app.graph()), CompileNfa(BuildCsr(other)));
+        f64 ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+        std::string stats = std::to_string(result.pairs) + " PAIRS IN " + std::to_string(ms) + " MS";
+        if (result.equivalent)
+        {
+            app.message = "EQUIVALENT: " + stats;
+        }
+        else
+        {
+            app.message = "DIFFERENT: " + EscapeBytes(result.counterexample) + " IS ACCEPTED ONLY BY "
+                + (result.accepted_by_a ? "THE CANVAS" : app.other_path) + ", " + stats;
+        }
+    }
+    catch (const std::runtime_error& e)
+    {
+        app.message = e.what();
+        V_LOG_ERROR(e.what());
+    }
+}
+
+void CheckIncludedInOther(App& app)
+{
+    try
+    {
+        NodeStore other = {};
+        ParseCanvas(LoadFile(app.other_path), other, nullptr);
+
+        auto begin = std::chrono::steady_clock::now();
+        InclusionResult result = CheckInclusion(CompileNfa(app.graph()), CompileNfa(BuildCsr(other)));
+        f64 ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+        std::string stats = std::to_string(result.pairs) + " PAIRS IN " + std::to_string(ms) + " MS";
+        if (result.included)
+        {
+            app.message = std::string("INCLUDED IN ") + app.other_path + ": " + stats;
+        }
+        else
+        {
+            app.message = "NOT INCLUDED: " + EscapeBytes(result.counterexample) + " IS REJECTED BY " + app.other_path + ", " + stats;
+        }
+    }
+    catch (const std::runtime_error& e)
+    {
+        app.message = e.what();
+        V_LOG_ERROR(e.what());
+    }
+}
+
+// Without To canvas only enough of the product is built to find its
+// shortest word.
+void CombineWithOther(App& app, PRODUCT_OP op)
+{
+    try
+    {
+        NodeStore other = {};
+        ParseCanvas(LoadFile(app.other_path), other, nullptr);
+        Nfa a = CompileNfa(app.graph());
+        Nfa b = CompileNfa(BuildCsr(other));
+
+        auto begin = std::chrono::steady_clock::now();
+        LazyProduct product = MakeLazyProduct(a, b, op);
+        std::string word;
+        bool empty = !ShortestAccepted(product, &word);
+        Automaton dfa = {};
+        if (app.product_to_canvas) dfa = MaterializeProduct(product);
+        f64 ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+        std::string stats = std::to_string(product.num_states) + " PAIRS IN " + std::to_string(ms) + " MS";
+        if (app.product_to_canvas)
+        {
+            app.load_automaton(dfa);
+            stats = std::to_string(dfa.num_states - 1) + " STATES, " + stats;
+        }
+        app.message = (empty ? "EMPTY: " : "SHORTEST WORD " + EscapeBytes(word) + ": ") + stats;
+    }
+    catch (const std::runtime_error& e)
+    {
+        app.message = e.what();
+        V_LOG_ERROR(e.what());
+    }
+}
+
+Color ArcColor(const App& app, const arc& a)
+{
+    if (app.state == SIMULATE && app.sim.arc_taken(a)) return ARC_TAKEN_COLOR;
+    return ARC_COLOR;
+}
+
+void DeterminizeCanvas(App& app)
+{
+    try
+    {
+        auto begin = std::chrono::steady_clock::now();
+        Automaton dfa = Determinize(CompileNfa(app.graph()));
+        f64 ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - begin).count();
+        app.load_automaton(dfa);
+        app.message = "DETERMINIZED: " + std::to_string(dfa.num_states - 1) + " STATES IN " + std::to_string(ms) + " MS";
+    }
+    catch (const std::runtime_error& e)
+    {
+        app.message = e.what();
+        V_LOG_ERROR(e.what());
+    }
+}
+
+void MinimizeCanvas(App& app)
+{
+    try
+    {
+        MinimizeStats stats;
+        Automaton dfa = Minimize(CompileDeterministic(app.graph()), &stats);
+        app.load_automaton(dfa);
+        app.message = "MINIMIZED: " + std::to_string(stats.states_before - 1) + " -> " + std::to_string(stats.states_after - 1)
+            + " STATES, " + std::to_string(stats.num_classes) + " BYTE CLASSES IN " + std::to_string(stats.ms) + " MS, "
+            + std::to_string(stats.bytes / 1024) + " KB";
+    }
+    catch (const std::runtime_error& e)
+    {
+        app.message = e.what();
+        V_LOG_ERROR(e.what());
+    }
+}
+
+void ExportCpp(App& app)
+{
+    std::string path = app.export_path;
+    std::string name = path.substr(path.find_last_of("/\\") + 1);
+    name = name.substr(0, name.find('.'));
+
+    try
+    {
+        Automaton dfa = CompileAutomaton(app.graph());
+        SaveFile(path, GenerateCpp(dfa, name, app.export_constexpr));
+        app.message = "EXPORTED TO " + path;
+    }
+    catch (const std::runtime_error& e)
+    {
+        app.message = e.what();
+        V_LOG_ERROR(e.what());
+    }
+}
@@ -1,20 +1,111 @@
 
-#include <sstream>
 #include "vgeneral.h"
 #include <fstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 
 std::string LoadFile(const std::string& path)
 {
-	std::ifstream file(path);
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
 
 	if (!file.is_open())
 	{
 		throw std::runtime_error("FAILED TO OPEN FILE: " + path);
 	} 
-	
-	std::stringstream buff;
-	buff << file.rdbuf();
+
+	// Read straight into the result instead of going through a stringstream,
+	// which kept two copies of the file alive.
+	std::string buff;
+	buff.resize((size_t)file.tellg());
+	file.seekg(0);
+	file.read(&buff[0], buff.size());
+	file.close();
+	return buff;
+}
+
+
+void SaveFile(const std::string& path, const std::string& contents)
+{
+	std::ofstream file(path, std::ios::binary);
+
+	if (!file.is_open())
+	{
+		throw std::runtime_error("FAILED TO OPEN FILE: " + path);
+	}
+
+	file.write(contents.data(), contents.size());
 	file.close();
-	return buff.str();
+}
+
+
+MappedFile MapFile(const std::string& path)
+{
+	MappedFile file = { nullptr, 0, nullptr };
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (handle == INVALID_HANDLE_VALUE)
+	{
+		throw std::runtime_error("FAILED TO OPEN FILE: " + path);
+	}
+	LARGE_INTEGER size;
+	if (GetFileType(handle) != FILE_TYPE_DISK || !GetFileSizeEx(handle, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(handle);
+		return file;
+	}
+	HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(handle);
+	if (!mapping) return file;
+	file.data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!file.data)
+	{
+		CloseHandle(mapping);
+		return file;
+	}
+	file.size = (size_t)size.QuadPart;
+	file.handle = mapping;
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		throw std::runtime_error("FAILED TO OPEN FILE: " + path);
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+	{
+		close(fd);
+		return file;
+	}
+	void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) return file;
+	madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+	file.data = (const char*)data;
+	file.size = (size_t)st.st_size;
+#endif
+	return file;
+}
+
+
+void UnmapFile(MappedFile& file)
+{
+	if (!file.data) return;
+#ifdef _WIN32
+	UnmapViewOfFile(file.data);
+	CloseHandle((HANDLE)file.handle);
+#else
+	munmap((void*)file.data, file.size);
+#endif
+	file = { nullptr, 0, nullptr };
 }
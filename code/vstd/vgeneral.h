@@ -1,7 +1,28 @@
 #ifndef VGENERAL
 #define VGENERAL
 
+#include <string>
 
 std::string LoadFile(const std::string& path);
+void SaveFile(const std::string& path, const std::string& contents);
+
+// Read only view of a whole file. data is null when the file can not be
+// mapped (pipes, character devices), callers then fall back to reading.
+struct MappedFile
+{
+	const char* data;
+	size_t size;
+	void* handle;
+};
+
+MappedFile MapFile(const std::string& path);
+void UnmapFile(MappedFile& file);
+
+// Releases the mapping on every way out, a throw included.
+struct MappingGuard
+{
+	MappedFile file;
+	~MappingGuard() { if (file.data) UnmapFile(file); }
+};
 
 #endif
@@ -5,7 +5,7 @@
 #include <string>
 #include <stdint.h>
 
-typedef uint32_t u64;
+typedef uint64_t u64;
 typedef uint32_t u32;
 typedef uint16_t u16;
 typedef uint8_t   u8;
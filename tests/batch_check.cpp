@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+#include "automata/batch.h"
+#include "automata/csr.h"
+#include "automata/determinize.h"
+#include "check.h"
+
+// AcceptsBatch has to give dfa.accepts for every input, whatever length
+// bucket, lane group or window it lands in.
+static void CheckSameAsAccepts(const std::string& pattern, std::mt19937& rng)
+{
+    Automaton dfa = CompileDeterministic(BuildCsr(CanvasFromRegex(CompileRegex(pattern, REGEX_GLUSHKOV))));
+
+    // Empty inputs, every bucketed length, lengths right around the bucket
+    // limit and long inputs that share refilled lanes. More inputs than one
+    // window, so groups straddle window and lane boundaries.
+    std::vector<std::string> words;
+    for (i32 i = 0; i < 40; i++) words.push_back("");
+    for (size_t len = 0; len <= 300; len++)
+    {
+        for (i32 copies = 1 + rng() % (BATCH_LANES + 3); copies > 0; copies--) words.push_back(std::string(len, 'a'));
+    }
+    for (i32 i = 0; i < 6000; i++)
+    {
+        size_t len = rng() % 4 == 0 ? 250 + rng() % 2000 : rng() % 40;
+        std::string word(len, 'a');
+        for (char& c: word) c = "abc\n"[rng() % 4];
+        words.push_back(word);
+    }
+    std::shuffle(words.begin(), words.end(), rng);
+
+    std::vector<std::string_view> inputs(words.begin(), words.end());
+    std::vector<u8> results(inputs.size(), 2);
+    AcceptsBatch(dfa, inputs.data(), inputs.size(), results.data());
+
+    i32 wrong = 0;
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        if (results[i] != (u8)dfa.accepts(inputs[i]) && wrong++ < 5)
+        {
+            Check(false, pattern + ": input " + std::to_string(i) + " of length " + std::to_string(inputs[i].size()));
+        }
+    }
+    Check(wrong == 0, pattern + ": " + std::to_string(wrong) + " inputs differ");
+
+    // Counts below a full lane group and a single input.
+    for (size_t count: {size_t(0), size_t(1), size_t(BATCH_LANES - 1), size_t(BATCH_LANES + 1)})
+    {
+        std::vector<u8> few(count + 1, 2);
+        AcceptsBatch(dfa, inputs.data(), count, few.data());
+        for (size_t i = 0; i < count; i++)
+        {
+            Check(few[i] == (u8)dfa.accepts(inputs[i]), pattern + ": " + std::to_string(count) + " inputs, input " + std::to_string(i));
+        }
+        Check(few[count] == 2, pattern + ": wrote past " + std::to_string(count) + " results");
+    }
+}
+
+int main()
+{
+    std::mt19937 rng(8);
+    CheckSameAsAccepts("a*", rng);
+    CheckSameAsAccepts("(a|b)*c", rng);
+    CheckSameAsAccepts("(.|\\n)*a(.|\\n)(.|\\n)(.|\\n)(.|\\n)(.|\\n)(.|\\n)b", rng);
+    CheckSameAsAccepts("((a|b|c|\\n)(a|b|c|\\n))*", rng);
+    return check_failures;
+}
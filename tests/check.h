@@ -0,0 +1,40 @@
+#pragma once
+#ifndef CHECK
+#define CHECK
+
+#include <cstdio>
+#include <string>
+#include "graph.h"
+#include "automata/regex.h"
+#include "vstd/vtypes.h"
+
+// Every failed check is printed; a check program exits with the number of
+// failures, so ctest reports it as failed when there was at least one.
+inline i32 check_failures = 0;
+
+inline void Check(bool ok, const std::string& what)
+{
+    if (ok) return;
+    check_failures++;
+    fprintf(stderr, "FAILED: %s\n", what.c_str());
+}
+
+// The canvas the app draws for a compiled pattern, node s + 1 for state s.
+inline NodeStore CanvasFromRegex(const RegexGraph& graph)
+{
+    NodeStore nodes = {};
+    for (i32 s = 0; s < graph.num_states; s++)
+    {
+        NODE_KIND kind = graph.accepting[s] ? GOAL : NORMAL;
+        if (s == 0) kind = kind == GOAL ? INIT_GOAL : INIT;
+        nodes.place(s + 1, kind, {0.0f, 0.0f}, 10.0f);
+    }
+    for (const auto& a: graph.arcs)
+    {
+        bool epsilon = a.bytes == REGEX_EPSILON;
+        nodes.add_arc(a.from + 1, a.to + 1, epsilon ? ByteSet{} : graph.sets[a.bytes], epsilon);
+    }
+    return nodes;
+}
+
+#endif
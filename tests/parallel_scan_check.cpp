@@ -0,0 +1,49 @@
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include "automata/csr.h"
+#include "automata/determinize.h"
+#include "automata/parallel_scan.h"
+#include "check.h"
+
+static void Collect(u64 end_offset, void* user)
+{
+    ((std::vector<u64>*)user)->push_back(end_offset);
+}
+
+static void ThrowOnMatch(u64, void*)
+{
+    throw std::runtime_error("CALLBACK");
+}
+
+int main()
+{
+    std::mt19937 rng(5);
+    std::string input(6 * PARALLEL_SCAN_MIN_CHUNK + 7, 'a');
+    for (char& c: input) c = "abc"[rng() % 3];
+    Automaton dfa = CompileDeterministic(BuildCsr(CanvasFromRegex(CompileRegex(".*a(b|c)c", REGEX_GLUSHKOV))));
+
+    std::vector<u64> expected;
+    u32 end = dfa.find_matches(input, dfa.start, 0, Collect, &expected);
+    for (i32 threads: {2, 3, 6})
+    {
+        std::string what = std::to_string(threads) + " threads";
+        Check(ParallelScan(dfa, input, dfa.start, threads) == end, what + ": end state differs");
+        std::vector<u64> found;
+        ParallelFindMatches(dfa, input, dfa.start, 0, Collect, &found, threads);
+        Check(found == expected, what + ": matches differ");
+
+        // The workers are joined and the exception reaches the caller.
+        bool thrown = false;
+        try
+        {
+            ParallelFindMatches(dfa, input, dfa.start, 0, ThrowOnMatch, nullptr, threads);
+        }
+        catch (const std::runtime_error&)
+        {
+            thrown = true;
+        }
+        Check(thrown, what + ": callback exception was lost");
+    }
+    return check_failures;
+}
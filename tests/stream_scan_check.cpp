@@ -0,0 +1,60 @@
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "automata/csr.h"
+#include "automata/determinize.h"
+#include "automata/stream_scan.h"
+#include "vstd/vgeneral.h"
+#include "check.h"
+
+static void Collect(u64 end_offset, void* user)
+{
+    ((std::vector<u64>*)user)->push_back(end_offset);
+}
+
+static Automaton Compile(const std::string& pattern)
+{
+    return CompileDeterministic(BuildCsr(CanvasFromRegex(CompileRegex(pattern, REGEX_GLUSHKOV))));
+}
+
+// The mapped path (serial and split across threads) and the chunked read
+// fallback have to report the same offsets as one pass over the whole input.
+static void CheckSameMatches(const std::string& pattern, const std::string& input, const std::string& path)
+{
+    Automaton dfa = Compile(pattern);
+    std::vector<u64> expected, mapped, split, streamed;
+    dfa.find_matches(input, dfa.start, 0, Collect, &expected);
+
+    ScanFile(dfa, path, Collect, &mapped, 1);
+    ScanFile(dfa, path, Collect, &split, 4);
+    FILE* stream = fopen(path.c_str(), "rb");
+    ScanStream(dfa, stream, Collect, &streamed);
+    fclose(stream);
+
+    std::string what = pattern + " over " + std::to_string(input.size()) + " bytes";
+    Check(!expected.empty(), what + ": no matches to compare");
+    Check(mapped == expected, what + ": mapped scan differs");
+    Check(split == expected, what + ": mapped scan on 4 threads differs");
+    Check(streamed == expected, what + ": chunked read differs");
+}
+
+int main()
+{
+    // Large enough for several STREAM_SCAN_BUFFER pieces and one
+    // PARALLEL_SCAN_MIN_CHUNK per thread.
+    std::mt19937 rng(6);
+    std::string input(5 * STREAM_SCAN_BUFFER + 123, 'a');
+    for (char& c: input) c = "abc\n"[rng() % 4];
+    std::string path = "stream_scan_check.tmp";
+    SaveFile(path, input);
+
+    MappingGuard mapping = {MapFile(path)};
+    Check(mapping.file.data != nullptr && mapping.file.size == input.size(), "regular file was not mapped");
+
+    CheckSameMatches("(.|\\n)*abc", input, path);
+    CheckSameMatches("(.|\\n)*a(b|c)*\\n", input, path);
+    CheckSameMatches("(.|\\n)*cc(.|\\n)*", input, path);
+
+    remove(path.c_str());
+    return check_failures;
+}
@@ -0,0 +1,86 @@
+#include <random>
+#include <stdexcept>
+#include "automata/csr.h"
+#include "automata/equivalence.h"
+#include "automata/nfa.h"
+#include "automata/regex.h"
+#include "automata/to_regex.h"
+#include "check.h"
+
+static ByteSet Bytes(const std::string& text)
+{
+    return ParseByteSet(text);
+}
+
+static ByteSet AllBytes()
+{
+    ByteSet bytes = {};
+    ByteSetAddRange(bytes, 0, ALPHABET_SIZE - 1);
+    return bytes;
+}
+
+// CompileRegex(CanvasToRegex(c)) has to accept the same words as c.
+static void CheckRoundTrip(const NodeStore& nodes, const std::string& what)
+{
+    CanvasCsr csr = BuildCsr(nodes);
+    std::string regex = CanvasToRegex(csr);
+    try
+    {
+        for (auto construction: {REGEX_GLUSHKOV, REGEX_THOMPSON})
+        {
+            NodeStore back = CanvasFromRegex(CompileRegex(regex, construction));
+            EquivalenceResult result = CheckEquivalence(CompileNfa(csr), CompileNfa(BuildCsr(back)));
+            Check(result.equivalent, what + ": " + regex + " differs on " + result.counterexample);
+        }
+    }
+    catch (const std::runtime_error& e)
+    {
+        Check(false, what + ": " + regex + ": " + e.what());
+    }
+}
+
+static void CheckFullAlphabet()
+{
+    Check(ByteSetText(AllBytes()) == "[\\x00-\\xFF]", "every byte is " + ByteSetText(AllBytes()));
+
+    NodeStore one = {};
+    i32 a = one.add(INIT, {0.0f, 0.0f}, 10.0f);
+    i32 b = one.add(GOAL, {0.0f, 0.0f}, 10.0f);
+    one.add_arc(a, b, AllBytes());
+    one.add_arc(b, b, AllBytes());
+    CheckRoundTrip(one, "full alphabet arc");
+
+    // . and \n only cover every byte once they are merged.
+    NodeStore merged = {};
+    a = merged.add(INIT, {0.0f, 0.0f}, 10.0f);
+    b = merged.add(GOAL, {0.0f, 0.0f}, 10.0f);
+    merged.add_arc(a, b, Bytes("^\\n"));
+    merged.add_arc(a, b, Bytes("\\n"));
+    CheckRoundTrip(merged, "dot and newline");
+}
+
+static void CheckRandomCanvases()
+{
+    std::mt19937 rng(17);
+    const ByteSet labels[] = {Bytes("a"), Bytes("b"), Bytes("a-c"), Bytes("^a"), Bytes("^\\n"), AllBytes()};
+    for (i32 iter = 0; iter < 300; iter++)
+    {
+        NodeStore nodes = {};
+        i32 n = 1 + rng() % 8;
+        for (i32 i = 0; i < n; i++) nodes.add((NODE_KIND)(1 + rng() % 4), {0.0f, 0.0f}, 10.0f);
+        i32 m = rng() % (2 * n + 1);
+        for (i32 k = 0; k < m; k++)
+        {
+            bool epsilon = rng() % 6 == 0;
+            nodes.add_arc(1 + rng() % n, 1 + rng() % n, labels[rng() % 6], epsilon);
+        }
+        CheckRoundTrip(nodes, "random canvas " + std::to_string(iter));
+    }
+}
+
+int main()
+{
+    CheckFullAlphabet();
+    CheckRandomCanvases();
+    return check_failures;
+}